@@ -4,6 +4,11 @@
 #include <string>
 #include <cctype>
 #include <stdexcept>
+#include <new>
+#include <utility>
+#include <memory>
+#include <limits>
+#include <type_traits>
 
 using namespace std;
 
@@ -70,6 +75,295 @@ void testArrayStack() {
     assert(stack0.isEmpty());
 }
 
+constexpr int DEFAULT_INLINE_CAPACITY = 16;
+
+// An array stack without a capacity limit. The first INLINE_CAPACITY values are kept
+// inside the stack object itself, so shallow stacks never allocate. Deeper stacks move to
+// a buffer from 'Allocator' that doubles in size whenever it fills up. Values can be
+// moved in with push(T&&) or built in place with emplace().
+template<typename T, int INLINE_CAPACITY = DEFAULT_INLINE_CAPACITY, typename Allocator = std::allocator<T>>
+class DynamicArrayStack final : public StackADT<T> {
+private:
+    using Traits = allocator_traits<Allocator>;
+
+    [[no_unique_address]] Allocator allocator;
+    T* data;
+    int count;
+    int capacity;
+    alignas(T) unsigned char inlineStorage[INLINE_CAPACITY * sizeof(T)];
+
+    T* inlineData() {
+        return reinterpret_cast<T*>(inlineStorage);
+    }
+
+    bool isInline() const {
+        return data == reinterpret_cast<const T*>(inlineStorage);
+    }
+
+    // Destroy the values and give back any heap buffer, leaving an empty inline stack.
+    void reset() {
+        while(pop()) {}
+        if (!isInline()) {
+            Traits::deallocate(allocator, data, capacity);
+        }
+        data = inlineData();
+        capacity = INLINE_CAPACITY;
+    }
+
+    // Take over the values of 'other', moving them one by one when its buffer cannot be
+    // taken whole, and leave 'other' empty.
+    void takeFrom(DynamicArrayStack & other) {
+        if (!other.isInline() && allocator == other.allocator) {
+            data = exchange(other.data, other.inlineData());
+            count = exchange(other.count, 0);
+            capacity = exchange(other.capacity, INLINE_CAPACITY);
+            return;
+        }
+        for (int i = 0; i < other.count; ++i) {
+            emplace(std::move(other.data[i]));
+        }
+        other.reset();
+    }
+
+public:
+    static_assert(INLINE_CAPACITY > 0);
+
+    DynamicArrayStack() : DynamicArrayStack(Allocator()) {}
+    explicit DynamicArrayStack(const Allocator & allocator)
+        : allocator(allocator), data(inlineData()), count(0), capacity(INLINE_CAPACITY) {}
+
+    ~DynamicArrayStack() {
+        reset();
+    }
+
+    // Copy constructor
+    DynamicArrayStack(const DynamicArrayStack & other)
+        : DynamicArrayStack(Traits::select_on_container_copy_construction(other.allocator)) {
+        if (other.count > INLINE_CAPACITY) {
+            data = Traits::allocate(allocator, other.count);
+            capacity = other.count;
+        }
+        for (int i = 0; i < other.count; ++i) {
+            Traits::construct(allocator, data + i, other.data[i]);
+            ++count;
+        }
+    }
+
+    // Move constructor. A heap buffer is taken over; inline values have to be moved.
+    DynamicArrayStack(DynamicArrayStack && other) noexcept(is_nothrow_move_constructible_v<T>)
+        : DynamicArrayStack(other.allocator) {
+        takeFrom(other);
+    }
+
+    DynamicArrayStack & operator=(const DynamicArrayStack & other) {
+        if (this != &other) {
+            DynamicArrayStack copy(other);
+            *this = std::move(copy);
+        }
+        return *this;
+    }
+
+    DynamicArrayStack & operator=(DynamicArrayStack && other)
+        noexcept((Traits::propagate_on_container_move_assignment::value || Traits::is_always_equal::value)
+                 && is_nothrow_move_constructible_v<T>) {
+        if (this != &other) {
+            reset();
+            if constexpr (Traits::propagate_on_container_move_assignment::value) {
+                allocator = other.allocator;
+            }
+            takeFrom(other);
+        }
+        return *this;
+    }
+
+    bool isEmpty() const override {
+        return count == 0;
+    }
+
+    int size() const {
+        return count;
+    }
+
+    void push(const T & value) override {
+        emplace(value);
+    }
+
+    void push(T && value) {
+        emplace(std::move(value));
+    }
+
+    // Construct a new top value from 'args' and return it.
+    template<typename... Args>
+    T & emplace(Args &&... args) {
+        if (count < capacity) {
+            Traits::construct(allocator, data + count, std::forward<Args>(args)...);
+            return data[count++];
+        }
+        if (capacity > numeric_limits<int>::max() / 2) {
+            throw std::length_error("Max array exceeded.");
+        }
+
+        // Full: build the new value in a buffer twice the size before moving the others
+        // over, since 'args' may refer to one of them.
+        int newCapacity = capacity * 2;
+        T* newData = Traits::allocate(allocator, newCapacity);
+        int moved = -1;
+        try {
+            Traits::construct(allocator, newData + count, std::forward<Args>(args)...);
+            for (moved = 0; moved < count; ++moved) {
+                Traits::construct(allocator, newData + moved, std::move_if_noexcept(data[moved]));
+            }
+        } catch (...) {
+            if (moved >= 0) {
+                for (int i = 0; i < moved; ++i) {
+                    Traits::destroy(allocator, newData + i);
+                }
+                Traits::destroy(allocator, newData + count);
+            }
+            Traits::deallocate(allocator, newData, newCapacity);
+            throw;
+        }
+
+        int newCount = count + 1;
+        reset();
+        data = newData;
+        count = newCount;
+        capacity = newCapacity;
+        return data[count - 1];
+    }
+
+    T peek() const override {
+        if(isEmpty()) {
+            throw std::logic_error("Peek on empty DynamicArrayStack.");
+        }
+        return data[count - 1];
+    }
+
+    bool pop() override {
+        if(isEmpty()) {
+            return false;
+        }
+        Traits::destroy(allocator, data + --count);
+        return true;
+    }
+};
+
+// Allocator that counts the buffers it hands out, to see when a stack allocates.
+template<typename T>
+struct CountingAllocator {
+    using value_type = T;
+
+    int* allocations;
+
+    explicit CountingAllocator(int* allocations) : allocations(allocations) {}
+    template<typename U>
+    CountingAllocator(const CountingAllocator<U> & other) : allocations(other.allocations) {}
+
+    T* allocate(size_t n) {
+        ++*allocations;
+        return std::allocator<T>().allocate(n);
+    }
+
+    void deallocate(T* p, size_t n) {
+        std::allocator<T>().deallocate(p, n);
+    }
+
+    bool operator==(const CountingAllocator & other) const {
+        return allocations == other.allocations;
+    }
+};
+
+// Counts copies, to check that values are moved rather than copied.
+struct CopyCounted {
+    static int copies;
+    string text;
+
+    CopyCounted(string text = "") : text(std::move(text)) {}
+    CopyCounted(const CopyCounted & other) : text(other.text) {
+        ++copies;
+    }
+    CopyCounted(CopyCounted && other) noexcept = default;
+    CopyCounted & operator=(const CopyCounted & other) {
+        text = other.text;
+        ++copies;
+        return *this;
+    }
+    CopyCounted & operator=(CopyCounted && other) noexcept = default;
+};
+
+int CopyCounted::copies = 0;
+
+void testDynamicArrayStack() {
+    int allocations = 0;
+    CountingAllocator<int> counting(&allocations);
+    DynamicArrayStack<int, 4, CountingAllocator<int>> stack0(counting);
+    assert(stack0.isEmpty());
+    stack0.push(10);
+    assert(stack0.peek() == 10);
+    stack0.push(20);
+    assert(stack0.peek() == 20);
+    assert(stack0.pop());
+    assert(stack0.peek() == 10);
+    assert(stack0.pop());
+    assert(stack0.isEmpty());
+    assert(!stack0.pop());
+
+    // Shallow stacks stay in the inline buffer; deeper ones double as they go.
+    for (int i = 0; i < 4; ++i) {
+        stack0.push(i);
+    }
+    assert(allocations == 0);
+    for (int i = 4; i < 1000; ++i) {
+        stack0.push(i);
+    }
+    assert(allocations == 8); // 8, 16, ..., 1024
+    assert(stack0.size() == 1000);
+    assert(stack0.peek() == 999);
+
+    // Test copy constructor
+    DynamicArrayStack<int, 4, CountingAllocator<int>> stack1(stack0);
+    assert(allocations == 9);
+    for (int i = 999; i >= 0; --i) {
+        assert(stack1.peek() == i);
+        assert(stack1.pop());
+    }
+    assert(stack1.isEmpty());
+    assert(stack0.size() == 1000);
+
+    // Test move constructor: a heap buffer changes hands without allocating.
+    DynamicArrayStack<int, 4, CountingAllocator<int>> stack2(std::move(stack0));
+    assert(stack0.isEmpty());
+    assert(stack2.size() == 1000);
+    assert(allocations == 9);
+    stack0.push(1); // A moved-from stack is still usable.
+    assert(stack0.peek() == 1);
+
+    // Test move and copy assignment, also of an inline stack.
+    stack1 = std::move(stack2);
+    assert(stack1.peek() == 999 && stack2.isEmpty());
+    stack2 = std::move(stack0);
+    assert(stack2.peek() == 1 && stack0.isEmpty());
+    stack0 = stack1;
+    assert(stack0.size() == 1000 && stack1.size() == 1000);
+
+    // push(T&&) and emplace don't copy, not even when the stack grows.
+    CopyCounted::copies = 0;
+    DynamicArrayStack<CopyCounted, 2> strings;
+    strings.push(CopyCounted("moved"));
+    strings.emplace("built in place");
+    CopyCounted moved("moved too");
+    strings.push(std::move(moved));
+    assert(CopyCounted::copies == 0);
+    assert(strings.peek().text == "moved too");
+
+    // Growing while copying one of its own values.
+    DynamicArrayStack<string, 2> words;
+    string & first = words.emplace(100, 'x');
+    words.emplace("second");
+    words.push(first);
+    assert(words.peek() == string(100, 'x'));
+}
+
 template<typename T>
 class Node {
 private:
@@ -188,6 +482,185 @@ void testListStack() {
     assert(stack2.peek() == 3);
 }
 
+constexpr int POOL_CHUNK_NODES = 256;
+
+// A ListStack whose nodes are carved out of chunks of POOL_CHUNK_NODES nodes. Popped
+// nodes go onto a free list and the next push reuses them, so once the stack has been
+// as deep as it gets, push and pop never call new or delete.
+template<typename T>
+class PoolStack : public StackADT<T> {
+private:
+    // Storage for one node. An unused slot holds the free list link instead.
+    union Slot {
+        Slot* nextFree;
+        alignas(Node<T>) unsigned char storage[sizeof(Node<T>)];
+    };
+
+    struct Chunk {
+        Chunk* next;
+        Slot slots[POOL_CHUNK_NODES];
+    };
+
+    Node<T>* top;
+    Chunk* chunks; // Newest first; slots are handed out from the newest.
+    int usedSlots; // Slots of the newest chunk handed out so far.
+    Slot* freeSlots;
+
+    Node<T>* makeNode(const T & value, Node<T>* next) {
+        Slot* slot = freeSlots;
+        if (slot != nullptr) {
+            freeSlots = slot->nextFree;
+        } else {
+            if (chunks == nullptr || usedSlots == POOL_CHUNK_NODES) {
+                Chunk* chunk = new Chunk;
+                chunk->next = chunks;
+                chunks = chunk;
+                usedSlots = 0;
+            }
+            slot = &chunks->slots[usedSlots++];
+        }
+
+        try {
+            return new (slot->storage) Node<T>(value, next);
+        } catch (...) {
+            slot->nextFree = freeSlots; // Copying the value threw, keep the slot.
+            freeSlots = slot;
+            throw;
+        }
+    }
+
+    void freeNode(Node<T>* node) {
+        node->~Node();
+        Slot* slot = reinterpret_cast<Slot*>(node);
+        slot->nextFree = freeSlots;
+        freeSlots = slot;
+    }
+
+public:
+    PoolStack() : top(nullptr), chunks(nullptr), usedSlots(0), freeSlots(nullptr) {}
+    ~PoolStack() {
+        while(pop()) {} // Destroy the values, then hand the chunks back.
+        while (chunks != nullptr) {
+            delete exchange(chunks, chunks->next);
+        }
+    }
+
+    // Copy constructor
+    PoolStack(const PoolStack & other) : PoolStack() {
+        Node<T>* tail = nullptr;
+        for (Node<T>* current = other.top; current != nullptr; current = current->getNext()) {
+            Node<T>* newNode = makeNode(current->getValue(), nullptr);
+            if (tail == nullptr) {
+                top = newNode;
+            } else {
+                tail->setNext(newNode);
+            }
+            tail = newNode;
+        }
+    }
+
+    // Move constructor, takes the chunks along and leaves 'other' hollow.
+    PoolStack(PoolStack && other) noexcept
+        : top(exchange(other.top, nullptr)), chunks(exchange(other.chunks, nullptr)),
+          usedSlots(exchange(other.usedSlots, 0)), freeSlots(exchange(other.freeSlots, nullptr)) {}
+
+    // Copy and move assignment: 'other' is a copy, or the moved-from stack's contents.
+    PoolStack & operator=(PoolStack other) noexcept {
+        swap(top, other.top);
+        swap(chunks, other.chunks);
+        swap(usedSlots, other.usedSlots);
+        swap(freeSlots, other.freeSlots);
+        return *this;
+    }
+
+    bool isEmpty() const override {
+        return top == nullptr;
+    }
+
+    void push(const T & value) override {
+        top = makeNode(value, top);
+    }
+
+    T peek() const override {
+        if(isEmpty()) {
+            throw std::logic_error("Peek on empty PoolStack.");
+        }
+        return top->getValue();
+    }
+
+    bool pop() override {
+        if(isEmpty()) {
+            return false;
+        }
+        Node<T>* temp = top;
+        top = top->getNext();
+        freeNode(temp);
+        return true;
+    }
+};
+
+void testPoolStack() {
+    PoolStack<int> stack0;
+    assert(stack0.isEmpty());
+    stack0.push(10);
+    assert(stack0.peek() == 10);
+    stack0.push(20);
+    assert(stack0.peek() == 20);
+    assert(stack0.pop());
+    assert(stack0.peek() == 10);
+    assert(stack0.pop());
+    assert(stack0.isEmpty());
+    assert(!stack0.pop());
+
+    // Deeper than one chunk, then again from the free list.
+    for (int round = 0; round < 2; ++round) {
+        for (int i = 0; i < 3 * POOL_CHUNK_NODES; ++i) {
+            stack0.push(i);
+        }
+        for (int i = 3 * POOL_CHUNK_NODES - 1; i >= 0; --i) {
+            assert(stack0.peek() == i);
+            assert(stack0.pop());
+        }
+        assert(stack0.isEmpty());
+    }
+
+    // Test copy constructor
+    stack0.push(1);
+    stack0.push(2);
+    stack0.push(3);
+
+    PoolStack<int> stack1(stack0);
+    assert(stack0.peek() == 3);
+    assert(stack1.peek() == 3);
+    assert(stack1.pop() && stack1.peek() == 2);
+    assert(stack1.pop() && stack1.peek() == 1);
+    assert(stack1.pop() && stack1.isEmpty());
+    assert(stack0.peek() == 3);
+
+    // Test move constructor.
+    PoolStack<int> stack2(std::move(stack0));
+    assert(stack0.isEmpty());
+    assert(!stack2.isEmpty());
+    assert(stack2.peek() == 3);
+    stack0.push(4); // A moved-from stack is still usable.
+    assert(stack0.peek() == 4);
+
+    // Test copy and move assignment.
+    stack1 = stack2;
+    assert(stack1.peek() == 3 && stack2.peek() == 3);
+    stack0 = std::move(stack2);
+    assert(stack0.peek() == 3);
+    assert(stack2.isEmpty());
+
+    // Non-trivial values are destroyed on pop and with the stack.
+    PoolStack<string> words;
+    words.push("pooled");
+    words.push(string(100, 'x'));
+    assert(words.peek().size() == 100);
+    assert(words.pop());
+    assert(words.peek() == "pooled");
+}
+
 bool areCurleyBracesMatched(const string & inputString) {
     ListStack<char> stack;
     for (char ch : inputString) {
@@ -337,7 +810,9 @@ void testInfixToPostFix() {
 
 int main() {
     testArrayStack();
+    testDynamicArrayStack();
     testListStack();
+    testPoolStack();
     testAreCurleyBracesMatched();
     testIsPalindrome();
     testReversedString();
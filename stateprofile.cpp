@@ -3,13 +3,50 @@
 #include <sstream>
 #include <vector>
 #include <string>
+#include <string_view>
+#include <charconv>
+#include <cstring>
+#include <cerrno>
 #include <filesystem>
 #include <algorithm>
+#include <array>
+#include <iterator>
+#include <numeric>
+#include <limits>
+#include <utility>
+#include <tuple>
+#include <memory>
+#include <functional>
 #include <cmath>
+#include <cctype>
 #include <iomanip>
 #include <cstdlib>
 #include <future>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <queue>
+#include <random>
+#include <set>
+#include <map>
 #include <chrono>
+#include <cstdint>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <signal.h>
+#include <sys/inotify.h>
+#include <poll.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+#include <zlib.h>
 #include <jsoncpp/json/json.h>
 #include <opencv2/opencv.hpp>
 
@@ -33,18 +70,40 @@ const string BODY_LANGUAGE_DIR = "/home/m30w/myenv/Thresholds/body_language/";
 // It's essentially the computer's way of organizing files.
 // Just like a folder on a computer, which helps ogranize documents.
 
+// Compiled candidate indexes are cached here, outside the candidate directories themselves
+// so that writing them does not bump the directory mtime they are keyed on.
+const string INDEX_CACHE_DIR = "/home/m30w/myenv/Thresholds/cache/";
+
+// Cached renderings of LOG_FILE.
+const string RENDER_CACHE_DIR = INDEX_CACHE_DIR + "render/";
+
 // All final files are stored in OUTPUT_DIR.
 const string OUTPUT_DIR = "/home/m30w/myenv/Thresholds/output/";
 
+// Each run renders into its own directory under STAGING_DIR before publishing to OUTPUT_DIR.
+// It must be on the same filesystem as OUTPUT_DIR for the final renames to be atomic.
+const string STAGING_DIR = "/home/m30w/myenv/Thresholds/staging/";
+
+// What each output set last published to OUTPUT_DIR, one "<set>.list" manifest per set.
+const string PUBLISHED_DIR = "/home/m30w/myenv/Thresholds/published/";
+
 // Log file to be embedded at the bottom in small font.
 const string LOG_FILE = "/home/m30w/log.txt";
 
 // The location of the USB camera snapshot.
 const string CAMERA_IMAGE = OUTPUT_DIR + "camera_snapshot.jpg";
 
+// The rendered LOG_FILE image.
+const string LOG_SCREENSHOT = OUTPUT_DIR + "log_screenshot.jpg";
+
 // Final output image name must be exactly "state_profile-0.jpg".
 const string FINAL_IMG_NAME = OUTPUT_DIR + "state_profile-0.jpg";
 
+// --timing-report keeps its per-run history and the summary here, outside OUTPUT_DIR.
+const string TIMING_DIR = "/home/m30w/myenv/Thresholds/timings/";
+const string TIMING_HISTORY = TIMING_DIR + "timing_history.csv";
+const string TIMING_REPORT = TIMING_DIR + "timing_report.json";
+
 // ---------------------------
 // Custom Error Codes
 // ---------------------------
@@ -52,25 +111,12 @@ const int ERR_NO_CORE_WORDS = 3;
 const int ERR_NO_CORE_EMOTIONS = 4;
 const int ERR_NO_BODY_LANG = 5;
 const int ERR_NO_CAMERA = 2;
+const int ERR_NO_PROFILE_IMAGE = 6;
 // Numbers is used to categorize errors
 
 // ---------------------------
 // Utility Functions
 // ---------------------------
-vector<string> readLogFile(const string &filePath)
-{
-    vector<string> lines; // A dynamic array types string named 'lines'
-    ifstream file(filePath); // 'ifstream' allows to read data from files on computer
-    string line;
-    while(getline(file, line))
-    {
-        if(!line.empty())
-            lines.push_back(line);
-    }
-    return lines;
-    // All of this only happend when 'filePath' opened successfully
-}
-
 string readFileContents(const string &filePath)
 {
     ifstream ifs(filePath);
@@ -106,6 +152,170 @@ bool fileExists(const string &filePath)
     // Will return false if filePath doesn't exist
 }
 
+// Suffix for a temp file that is renamed over its target once written: ".tmp<pid>-<n>", unique
+// to this call even when batch subjects on other threads write the same target.
+string tempSuffix() {
+    static atomic<unsigned> counter{0};
+    return ".tmp" + to_string(getpid()) + "-" + to_string(counter++);
+}
+
+// Write 'contents' to 'path' through a temp file and a rename, so a reader sees either the
+// old file or the new one. On failure the error is reported, the temp file removed and
+// 'path' left as it was.
+bool replaceFileContents(const string &path, string_view contents) {
+    string tmpPath = path + tempSuffix();
+    error_code ec;
+    {
+        ofstream out(tmpPath, ios::binary);
+        out.write(contents.data(), contents.size());
+        if (!out) ec = make_error_code(errc::io_error);
+    }
+    if (!ec) fs::rename(tmpPath, path, ec);
+    if (ec) {
+        cerr << "Error: Could not write " << path << ": " << ec.message() << endl;
+        fs::remove(tmpPath, ec);
+        return false;
+    }
+    return true;
+}
+
+// ---------------------------
+// Timing Instrumentation
+// ---------------------------
+// Optional latency recording for --timing-report. A ScopedTimer measures its enclosing scope
+// under a name; while recording is off it costs one relaxed atomic load and never reads the
+// clock, so the timers stay compiled in. Pipeline stages are recorded as "stage: <name>",
+// external tools as "tool: <name>". Each run's spans are appended to TIMING_HISTORY, and
+// TIMING_REPORT summarizes every span over the last TIMING_HISTORY_RUNS runs.
+const int TIMING_HISTORY_RUNS = 500;
+
+class TimingRecorder {
+public:
+    void enable() { enabled.store(true, memory_order_relaxed); }
+    bool isEnabled() const { return enabled.load(memory_order_relaxed); }
+
+    void record(string name, double ms) {
+        lock_guard<mutex> lock(spansMutex);
+        spans.emplace_back(move(name), ms);
+    }
+
+    // The spans recorded since the last call, in the order they finished.
+    vector<pair<string, double>> take() {
+        lock_guard<mutex> lock(spansMutex);
+        return exchange(spans, {});
+    }
+
+private:
+    atomic<bool> enabled{false};
+    mutex spansMutex;
+    vector<pair<string, double>> spans;
+};
+
+TimingRecorder &timingRecorder() {
+    static TimingRecorder recorder;
+    return recorder;
+}
+
+class ScopedTimer {
+public:
+    explicit ScopedTimer(string_view spanName) : active(timingRecorder().isEnabled()) {
+        if (!active) return;
+        name = spanName;
+        begin = chrono::steady_clock::now();
+    }
+    ~ScopedTimer() {
+        if (active)
+            timingRecorder().record(name, chrono::duration<double, milli>(chrono::steady_clock::now() - begin).count());
+    }
+    ScopedTimer(const ScopedTimer &) = delete;
+    ScopedTimer &operator=(const ScopedTimer &) = delete;
+
+private:
+    bool active;
+    string name;
+    chrono::steady_clock::time_point begin;
+};
+
+// Nearest-rank percentile; reorders 'samples'.
+double percentile(vector<double> &samples, double p) {
+    size_t rank = size_t(ceil(p * samples.size()));
+    auto nth = samples.begin() + (rank == 0 ? 0 : rank - 1);
+    nth_element(samples.begin(), nth, samples.end());
+    return *nth;
+}
+
+// A run is identified by its start in milliseconds since the epoch and its pid, written
+// "<ms>-<pid>", so runs finishing in the same millisecond stay apart. Older history rows
+// carry only the milliseconds and read back with pid 0.
+using TimingRunId = pair<int64_t, pid_t>;
+
+bool parseTimingRunId(string_view text, TimingRunId &run) {
+    const char *end = text.data() + text.size();
+    auto [next, ec] = from_chars(text.data(), end, run.first);
+    if (ec != errc()) return false;
+    run.second = 0;
+    if (next == end) return true;
+    if (*next != '-') return false;
+    auto pidResult = from_chars(next + 1, end, run.second);
+    return pidResult.ec == errc() && pidResult.ptr == end;
+}
+
+string formatTimingRunId(const TimingRunId &run) {
+    return to_string(run.first) + "-" + to_string(run.second);
+}
+
+// Append this run's spans to TIMING_HISTORY ("run,span,ms" rows, oldest runs dropped past
+// TIMING_HISTORY_RUNS) and rewrite TIMING_REPORT from it.
+void writeTimingReport(const vector<pair<string, double>> &spans) {
+    struct Row { TimingRunId run; string span; double ms; };
+    vector<Row> rows;
+    istringstream history(readFileContents(TIMING_HISTORY));
+    string line;
+    while (getline(history, line)) {
+        size_t first = line.find(','), last = line.rfind(',');
+        if (first == string::npos || first == last) continue; // Header or damaged row.
+        Row row { {}, line.substr(first + 1, last - first - 1), 0.0 };
+        if (parseTimingRunId(string_view(line).substr(0, first), row.run)
+            && from_chars(line.data() + last + 1, line.data() + line.size(), row.ms).ec == errc())
+            rows.push_back(move(row));
+    }
+    TimingRunId runId {
+        chrono::duration_cast<chrono::milliseconds>(chrono::system_clock::now().time_since_epoch()).count(), getpid()
+    };
+    for (const auto &span : spans)
+        rows.push_back({ runId, span.first, span.second });
+
+    set<TimingRunId> runs;
+    for (const Row &row : rows) runs.insert(row.run);
+    while (runs.size() > size_t(TIMING_HISTORY_RUNS)) runs.erase(runs.begin());
+    rows.erase(remove_if(rows.begin(), rows.end(), [&](const Row &row) { return !runs.count(row.run); }), rows.end());
+
+    error_code ec;
+    fs::create_directories(TIMING_DIR, ec);
+    ostringstream csv;
+    csv << "run,span,ms\n";
+    for (const Row &row : rows) csv << formatTimingRunId(row.run) << ',' << row.span << ',' << row.ms << '\n';
+    replaceFileContents(TIMING_HISTORY, csv.str());
+
+    // "last_ms" is this run's total for the span; the percentiles are over single samples.
+    map<string, vector<double>> samples;
+    map<string, double> lastRun;
+    for (const Row &row : rows) samples[row.span].push_back(row.ms);
+    for (const auto &span : spans) lastRun[span.first] += span.second;
+
+    Json::Value report;
+    report["run"] = formatTimingRunId(runId);
+    report["runs"] = Json::UInt64(runs.size());
+    for (auto &entry : samples) {
+        Json::Value &span = report["spans"][entry.first];
+        span["samples"] = Json::UInt64(entry.second.size());
+        if (lastRun.count(entry.first)) span["last_ms"] = lastRun[entry.first];
+        span["p50_ms"] = percentile(entry.second, 0.50);
+        span["p99_ms"] = percentile(entry.second, 0.99);
+    }
+    replaceFileContents(TIMING_REPORT, Json::writeString(Json::StreamWriterBuilder(), report) + "\n");
+}
+
 // ---------------------------
 // USB Camera Detection
 // ---------------------------
@@ -114,287 +324,3964 @@ bool isCameraDetected() {
 }
 
 // ---------------------------
-// Sensor Data Processing
+// Memory-Mapped Log Ingestion
 // ---------------------------
-// 1. Heart Rate: moving average with Z-score outlier removal.
-pair<double, double> computeHeartRateAverages(const vector<string>& lines) {
-    vector<double> bpms, spo2s;
-    for (const string &line : lines) {
-        double bpm = 0.0, spo2 = 0.0;
-        if (sscanf(line.c_str(), "BPM: %lf, SpO2: %lf", &bpm, &spo2) == 2) {
-            bpms.push_back(bpm);
-            spo2s.push_back(spo2);
-        }
-    }
-    if (bpms.empty() || spo2s.empty()) return {NAN, NAN};
-    auto average = [&](const vector<double> &v) -> double {
-        double sum = 0.0;
-        for (double d : v) sum += d;
-        return sum / v.size();
-    };
-    double meanBPM = average(bpms);
-    double meanSpO2 = average(spo2s);
-    auto stddev = [&](const vector<double> &v, double mean) -> double {
-        double sum = 0.0;
-        for (double d : v) sum += (d - mean) * (d - mean);
-        return sqrt(sum / v.size());
-    };
-    double stdBPM = stddev(bpms, meanBPM);
-    double stdSpO2 = stddev(spo2s, meanSpO2);
-    vector<double> filteredBPM, filteredSpO2;
-    for (double d : bpms)
-        if (fabs(d - meanBPM) <= 2 * stdBPM)
-            filteredBPM.push_back(d);
-    for (double d : spo2s)
-        if (fabs(d - meanSpO2) <= 2 * stdSpO2)
-            filteredSpO2.push_back(d);
-    double finalBPM = filteredBPM.empty() ? meanBPM : average(filteredBPM);
-    double finalSpO2 = filteredSpO2.empty() ? meanSpO2 : average(filteredSpO2);
-    return {finalBPM, finalSpO2};
-}
+// Files are parsed in place through string_view slices, so no line is ever copied into its
+// own std::string. Files that are only ever replaced by rename (the candidate index, binary
+// logs) are mapped read-only. Sensor logs are still being appended to and may be truncated
+// by logrotate's copytruncate at any moment; touching a mapped page past the new end of file
+// raises SIGBUS, so those are read into a buffer instead (readLogSnapshot()).
+class MappedFile {
+public:
+    explicit MappedFile(const string &filePath) {
+        int fd = ::open(filePath.c_str(), O_RDONLY);
+        if (fd < 0) return; // A missing log reads as an empty one.
+        struct stat st;
+        if (fstat(fd, &st) == 0 && st.st_size > 0) {
+            void *addr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (addr != MAP_FAILED) {
+                madvise(addr, st.st_size, MADV_SEQUENTIAL);
+                data = static_cast<const char *>(addr);
+                size = st.st_size;
+            }
+        }
+        ::close(fd); // The mapping stays valid after the descriptor is closed.
+    }
+    ~MappedFile() {
+        if (data) munmap(const_cast<char *>(data), size);
+    }
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+    MappedFile(MappedFile &&other) noexcept : data(other.data), size(other.size) {
+        other.data = nullptr;
+        other.size = 0;
+    }
 
-// 2. Temperature: median filtering.
-pair<double, double> computeTemperatureAverages(const vector<string>& lines) {
-    vector<double> ambients, objects;
-    for (const string &line : lines) {
-        double ambient = 0.0, objectT = 0.0;
-        if (sscanf(line.c_str(), "Ambient Temp: %lf C, Object Temp: %lf C", &ambient, &objectT) == 2) {
-            ambients.push_back(ambient);
-            objects.push_back(objectT);
+    string_view text() const { return { data, size }; }
+
+private:
+    const char *data = nullptr;
+    size_t size = 0;
+};
+
+// Read the log at 'filePath' into 'buffer' with pread(), reusing its capacity, and return
+// its text. A log truncated while it is read yields what was read before; a missing log
+// reads as an empty one.
+string_view readLogSnapshot(const string &filePath, string &buffer) {
+    buffer.clear();
+    int fd = ::open(filePath.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return {};
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        buffer.resize(st.st_size);
+        size_t got = 0;
+        while (got < buffer.size()) {
+            ssize_t n = pread(fd, buffer.data() + got, buffer.size() - got, off_t(got));
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) break;
+            got += size_t(n);
         }
+        buffer.resize(got);
     }
-    if (ambients.empty() || objects.empty()) return {NAN, NAN};
-    sort(ambients.begin(), ambients.end());
-    sort(objects.begin(), objects.end());
-    double medAmbient = ambients[ambients.size() / 2];
-    double medObject = objects[objects.size() / 2];
-    return {medAmbient, medObject};
+    ::close(fd);
+    return buffer;
 }
 
-// 3. Motion: compute RMS of gyroscope values and choose the minimum RMS.
-double computeBestMotionValue(const vector<string>& lines) {
-    double bestRMS = 1e9;
-    for (const string &line : lines) {
-        double ax, ay, az, gx, gy, gz;
-        if (sscanf(line.c_str(), "accel_x: %lf, accel_y: %lf, accel_z: %lf, gyro_x: %lf, gyro_y: %lf, gyro_z: %lf",
-                   &ax, &ay, &az, &gx, &gy, &gz) == 6) {
-            double rms = sqrt((gx*gx + gy*gy + gz*gz) / 3.0);
-            if (rms < bestRMS) bestRMS = rms;
+// Call fn(line) for every non-empty line of 'text'.
+template<typename Fn>
+void forEachLine(string_view text, Fn fn) {
+    const char *p = text.data();
+    const char *end = p + text.size();
+    while (p < end) {
+        const char *nl = static_cast<const char *>(memchr(p, '\n', end - p));
+        const char *lineEnd = nl ? nl : end;
+        if (lineEnd > p) fn(string_view(p, lineEnd - p));
+        p = lineEnd + 1;
+    }
+}
+
+// Hand-written replacement for the sscanf() format strings the logs are written with.
+// Follows the same rules: a blank in the pattern matches any run of whitespace (including
+// none), every other character must match exactly, and a number may be preceded by blanks.
+class LineScanner {
+public:
+    explicit LineScanner(string_view line) : p(line.data()), end(line.data() + line.size()) {}
+
+    bool literal(string_view pattern) {
+        for (char c : pattern) {
+            if (c == ' ') {
+                skipSpaces();
+            } else {
+                if (p == end || *p != c) return false;
+                ++p;
+            }
         }
+        return true;
+    }
+
+    bool number(double &value) {
+        skipSpaces();
+        if (p != end && *p == '+') ++p; // from_chars does not accept an explicit plus sign.
+        auto [next, ec] = from_chars(p, end, value);
+        if (ec != errc()) return false;
+        p = next;
+        return true;
+    }
+
+private:
+    void skipSpaces() {
+        while (p != end && isspace(static_cast<unsigned char>(*p))) ++p;
     }
-    return (bestRMS == 1e9) ? NAN : bestRMS;
+
+    const char *p;
+    const char *end;
+};
+
+// "BPM: %lf, SpO2: %lf"
+bool parseHeartRateLine(string_view line, double &bpm, double &spo2) {
+    LineScanner in(line);
+    return in.literal("BPM: ") && in.number(bpm) && in.literal(", SpO2: ") && in.number(spo2);
+}
+
+// "Ambient Temp: %lf C, Object Temp: %lf C"
+bool parseTemperatureLine(string_view line, double &ambient, double &objectT) {
+    LineScanner in(line);
+    return in.literal("Ambient Temp: ") && in.number(ambient) && in.literal(" C, Object Temp: ") && in.number(objectT);
+}
+
+// "accel_x: %lf, accel_y: %lf, accel_z: %lf, gyro_x: %lf, gyro_y: %lf, gyro_z: %lf"
+bool parseMotionLine(string_view line, double &ax, double &ay, double &az, double &gx, double &gy, double &gz) {
+    LineScanner in(line);
+    return in.literal("accel_x: ") && in.number(ax) && in.literal(", accel_y: ") && in.number(ay)
+        && in.literal(", accel_z: ") && in.number(az) && in.literal(", gyro_x: ") && in.number(gx)
+        && in.literal(", gyro_y: ") && in.number(gy) && in.literal(", gyro_z: ") && in.number(gz);
 }
 
 // ---------------------------
-// Candidate Selection Functions
+// Parallel Chunked Parsing
 // ---------------------------
-// Compute confidence percentage using sensor thresholds.
-double computeConfidence(double sensorValue, double low, double high) {
-    double mid = (low + high) / 2.0;
-    double rangeHalf = (high - low) / 2.0;
-    double diff = fabs(sensorValue - mid);
-    double conf = 100.0 - (diff / (rangeHalf + 1e-6)) * 50.0;
-    if (conf < 0) conf = 0;
-    if (conf > 100) conf = 100;
-    return conf;
+// Large logs are split into contiguous chunks that are parsed on separate threads.
+// Each chunk produces its own partial aggregate, and the partials are merged afterwards,
+// so the workers never share state and need no locking.
+
+// Don't bother spawning a thread for less log text than this.
+const size_t MIN_BYTES_PER_CHUNK = 1 << 20;
+
+// One chunk per hardware thread, but never chunks smaller than 'minChunkSize' items.
+size_t chunkCountFor(size_t itemCount, size_t minChunkSize) {
+    size_t workers = max<size_t>(1, thread::hardware_concurrency());
+    return max<size_t>(1, min(workers, itemCount / minChunkSize));
 }
 
-// For core words and emotions: iterate over each candidate JSON file.
-vector<pair<string, double>> selectTopCandidates(const string &dirPath, double sensorValue, int topCount, const string &type) {
-    vector<pair<string, double>> candidates;
-    for (const auto &entry : fs::directory_iterator(dirPath)) {
-        if (entry.path().extension() == ".json") {
-            ifstream file(entry.path());
-            if (!file.is_open()) continue;
-            Json::Value candidate;
-            file >> candidate;
-            file.close();
-            string label = candidate.get((type == "word" ? "word" : "emotion"), "").asString();
-            if (label.empty()) continue;
-            double conf1 = computeConfidence(sensorValue, candidate["heart_rate_range"][0].asDouble(), candidate["heart_rate_range"][1].asDouble());
-            double conf2 = computeConfidence(sensorValue, candidate["object_temp_range"][0].asDouble(), candidate["object_temp_range"][1].asDouble());
-            double conf3 = computeConfidence(sensorValue, candidate["ambient_temp_range"][0].asDouble(), candidate["ambient_temp_range"][1].asDouble());
-            double conf4 = computeConfidence(98.0, candidate["spo2_range"][0].asDouble(), candidate["spo2_range"][1].asDouble());
-            double avgConf = (conf1 + conf2 + conf3 + conf4) / 4.0;
-            candidates.push_back({ label, avgConf });
-        }
-    }
-    sort(candidates.begin(), candidates.end(), [](const auto &a, const auto &b) {
-        return a.second > b.second;
-    });
-    if (candidates.size() > (size_t)topCount)
-        candidates.resize(topCount);
-    return candidates;
+// Half-open [begin, end) item range of chunk 'index' out of 'chunkCount'.
+pair<size_t, size_t> chunkBounds(size_t itemCount, size_t chunkCount, size_t index) {
+    return { itemCount * index / chunkCount, itemCount * (index + 1) / chunkCount };
 }
 
-// For body language: choose the best candidate.
-pair<string, double> selectBestBodyLanguage(const string &dirPath, double sensorValue) {
-    string bestLabel = "";
-    double bestConf = -1.0;
-    for (const auto &entry : fs::directory_iterator(dirPath)) {
-        if (entry.path().extension() == ".json") {
-            ifstream file(entry.path());
-            if (!file.is_open()) continue;
-            Json::Value candidate;
-            file >> candidate;
-            file.close();
-            string label = candidate.get("position", "").asString();
-            if (label.empty()) continue;
-            double low = candidate["motion_values"]["acceleration_x"][0].asDouble();
-            double high = candidate["motion_values"]["acceleration_x"][1].asDouble();
-            double conf = computeConfidence(sensorValue, low, high);
-            if (conf > bestConf) {
-                bestConf = conf;
-                bestLabel = label;
-            }
+// Split 'text' into 'chunkCount' slices whose boundaries are moved forward to the next
+// newline, so no line is ever cut between two chunks.
+vector<string_view> splitIntoLineChunks(string_view text, size_t chunkCount) {
+    vector<string_view> chunks;
+    size_t begin = 0;
+    for (size_t i = 0; i < chunkCount && begin < text.size(); ++i) {
+        size_t end = max(begin, chunkBounds(text.size(), chunkCount, i).second);
+        if (end < text.size()) {
+            size_t nl = text.find('\n', end);
+            end = (nl == string_view::npos) ? text.size() : nl + 1;
         }
+        chunks.push_back(text.substr(begin, end - begin));
+        begin = end;
     }
-    return { bestLabel, bestConf };
+    if (chunks.empty()) chunks.push_back(text);
+    return chunks;
+}
+
+// Run fn(chunkIndex) for every chunk concurrently and return the results in chunk order.
+// The first chunk runs on the calling thread, so a single chunk costs no thread at all.
+template<typename Fn>
+auto runChunks(size_t chunkCount, Fn fn) -> vector<decltype(fn(size_t{}))> {
+    vector<future<decltype(fn(size_t{}))>> pending;
+    for (size_t i = 1; i < chunkCount; ++i)
+        pending.push_back(async(launch::async, fn, i));
+    vector<decltype(fn(size_t{}))> results;
+    results.push_back(fn(0));
+    for (auto &f : pending)
+        results.push_back(f.get());
+    return results;
 }
 
 // ---------------------------
-// USB Camera Snapshot
+// Thread Pool
 // ---------------------------
-bool captureCameraSnapshot(const string &imagePath) {
-    cv::VideoCapture cap(0);
-    if (!cap.isOpened()) {
-        cerr << "Error: USB camera not detected." << endl;
-        return false;
+// A fixed set of worker threads fed from one job queue. Unlike one std::async per job,
+// the number of threads stays bounded however many jobs are queued at once.
+class ThreadPool {
+public:
+    explicit ThreadPool(size_t workerCount) {
+        for (size_t i = 0; i < max<size_t>(1, workerCount); ++i)
+            workers.emplace_back([this] { workerLoop(); });
     }
-    cv::Mat frame;
-    cap >> frame;
-    if (frame.empty()) {
-        cerr << "Error: Captured empty frame from camera." << endl;
-        return false;
+
+    ~ThreadPool() {
+        {
+            lock_guard<mutex> lock(queueMutex);
+            stopping = true;
+        }
+        wakeUp.notify_all();
+        for (thread &worker : workers) worker.join();
     }
-    cv::imwrite(imagePath, frame);
-    return true;
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    template<typename Fn>
+    auto submit(Fn fn) -> future<decltype(fn())> {
+        auto task = make_shared<packaged_task<decltype(fn())()>>(move(fn));
+        future<decltype(fn())> result = task->get_future();
+        {
+            lock_guard<mutex> lock(queueMutex);
+            jobs.push([task] { (*task)(); });
+        }
+        wakeUp.notify_one();
+        return result;
+    }
+
+private:
+    void workerLoop() {
+        for (;;) {
+            function<void()> job;
+            {
+                unique_lock<mutex> lock(queueMutex);
+                wakeUp.wait(lock, [this] { return stopping || !jobs.empty(); });
+                if (jobs.empty()) return; // Stopping and nothing left to do.
+                job = move(jobs.front());
+                jobs.pop();
+            }
+            job();
+        }
+    }
+
+    vector<thread> workers;
+    queue<function<void()>> jobs;
+    mutex queueMutex;
+    condition_variable wakeUp;
+    bool stopping = false;
+};
+
+// Shared pool for parsing candidate files. Jobs must never block on other pool jobs.
+ThreadPool &candidateParsePool() {
+    static ThreadPool pool(thread::hardware_concurrency());
+    return pool;
 }
 
 // ---------------------------
-// Document Generation
+// SIMD Sensor Kernels
 // ---------------------------
-// Create a DOCX file from content via pandoc.
-void createDocxDirectly(const string &docxPath, const string &content) {
-    string command = "echo \"" + escapeShellArg(content) + "\" | pandoc -f markdown -o " + docxPath + " --resource-path=" + OUTPUT_DIR;
-    system(command.c_str());
+// Parsed samples are gathered into fixed-size structure-of-arrays blocks and the sensor
+// math runs over whole blocks. Each kernel has a scalar version, an SSE2 version (always
+// present on x86-64) and an AVX2 version; the best one the CPU supports is picked once at
+// runtime, so the same binary runs on every host. Other architectures use the scalar code.
+const size_t SAMPLE_BLOCK_SIZE = 1024;
+
+template<int Fields>
+struct SampleBlock {
+    double column[Fields][SAMPLE_BLOCK_SIZE];
+    size_t size = 0;
+
+    bool full() const { return size == SAMPLE_BLOCK_SIZE; }
+};
+
+struct SensorKernels {
+    const char *name;
+    double (*sum)(const double *v, size_t n);
+    double (*sumSquaredDeviations)(const double *v, size_t n, double mean);
+    // Sum and count of the values with |v - mean| <= limit.
+    void (*sumWithinLimit)(const double *v, size_t n, double mean, double limit, double &sum, size_t &count);
+    // Smallest x*x + y*y + z*z over the three columns.
+    double (*minSumOfSquares3)(const double *x, const double *y, const double *z, size_t n);
+    // Candidate scoring: out[i] is the mean of the four computeConfidence() values of
+    // sensor[d] against the range [low[d][i], high[d][i]], d = 0..3.
+    void (*averageConfidence4)(const double *const low[4], const double *const high[4], const double sensor[4],
+                               size_t n, double *out);
+};
+
+double sumScalar(const double *v, size_t n) {
+    double s = 0.0;
+    for (size_t i = 0; i < n; ++i) s += v[i];
+    return s;
 }
 
-// ---------------------------
-// Convert DOCX to JPG
-// ---------------------------
-// Convert DOCX to PDF via LibreOffice and then to JPG via ImageMagick.
-void convertDocxToJpg(const string &docxPath, const string &imgPath) {
-    string command = "libreoffice --headless --convert-to pdf " + docxPath + " --outdir " + OUTPUT_DIR;
-    system(command.c_str());
-    string pdfPath = OUTPUT_DIR + "state_profile.pdf";
-    command = "convert -density 150 " + pdfPath + " -quality 90 " + imgPath;
-    system(command.c_str());
-    if (fs::exists(pdfPath)) fs::remove(pdfPath);
-    // The DOCX is preserved.
+double sumSquaredDeviationsScalar(const double *v, size_t n, double mean) {
+    double s = 0.0;
+    for (size_t i = 0; i < n; ++i) s += (v[i] - mean) * (v[i] - mean);
+    return s;
 }
 
-// ---------------------------
-// Create Log Screenshot
-// ---------------------------
-// Generate an image from the full contents of LOG_FILE using ImageMagick's caption.
-void createLogScreenshot() {
-    string logText = readFileContents(LOG_FILE);
-    if (logText.empty()) logText = "No log data available.";
-    replace(logText.begin(), logText.end(), '\n', ' ');
-    string escapedLog = escapeShellArg(logText);
-    string command = "convert -background white -fill black -font Liberation-Sans -pointsize 12 caption:\"" 
-                     + escapedLog + "\" " + OUTPUT_DIR + "log_screenshot.jpg";
-    system(command.c_str());
+void sumWithinLimitScalar(const double *v, size_t n, double mean, double limit, double &sum, size_t &count) {
+    for (size_t i = 0; i < n; ++i) {
+        if (fabs(v[i] - mean) <= limit) {
+            sum += v[i];
+            ++count;
+        }
+    }
+}
+
+double minSumOfSquares3Scalar(const double *x, const double *y, const double *z, size_t n) {
+    double best = INFINITY;
+    for (size_t i = 0; i < n; ++i)
+        best = min(best, x[i] * x[i] + y[i] * y[i] + z[i] * z[i]);
+    return best;
+}
+
+// Same arithmetic as computeConfidence(), but the clamping is min/max instead of branches.
+// NaN inputs stay NaN, as they do there.
+void averageConfidence4Scalar(const double *const low[4], const double *const high[4], const double sensor[4],
+                              size_t n, double *out) {
+    for (size_t i = 0; i < n; ++i) {
+        double total = 0.0;
+        for (int d = 0; d < 4; ++d) {
+            double mid = (low[d][i] + high[d][i]) / 2.0;
+            double rangeHalf = (high[d][i] - low[d][i]) / 2.0;
+            double conf = 100.0 - (fabs(sensor[d] - mid) / (rangeHalf + 1e-6)) * 50.0;
+            total += min(max(conf, 0.0), 100.0);
+        }
+        out[i] = total / 4.0;
+    }
+}
+
+const SensorKernels SCALAR_KERNELS = {
+    "scalar", sumScalar, sumSquaredDeviationsScalar, sumWithinLimitScalar, minSumOfSquares3Scalar,
+    averageConfidence4Scalar
+};
+
+#if defined(__x86_64__)
+double sumSSE2(const double *v, size_t n) {
+    __m128d acc = _mm_setzero_pd();
+    size_t i = 0;
+    for (; i + 2 <= n; i += 2) acc = _mm_add_pd(acc, _mm_loadu_pd(v + i));
+    double lanes[2];
+    _mm_storeu_pd(lanes, acc);
+    return lanes[0] + lanes[1] + sumScalar(v + i, n - i);
+}
+
+double sumSquaredDeviationsSSE2(const double *v, size_t n, double mean) {
+    __m128d m = _mm_set1_pd(mean), acc = _mm_setzero_pd();
+    size_t i = 0;
+    for (; i + 2 <= n; i += 2) {
+        __m128d d = _mm_sub_pd(_mm_loadu_pd(v + i), m);
+        acc = _mm_add_pd(acc, _mm_mul_pd(d, d));
+    }
+    double lanes[2];
+    _mm_storeu_pd(lanes, acc);
+    return lanes[0] + lanes[1] + sumSquaredDeviationsScalar(v + i, n - i, mean);
+}
+
+void sumWithinLimitSSE2(const double *v, size_t n, double mean, double limit, double &sum, size_t &count) {
+    const __m128d signMask = _mm_set1_pd(-0.0);
+    __m128d m = _mm_set1_pd(mean), lim = _mm_set1_pd(limit), acc = _mm_setzero_pd();
+    size_t i = 0;
+    for (; i + 2 <= n; i += 2) {
+        __m128d x = _mm_loadu_pd(v + i);
+        __m128d keep = _mm_cmple_pd(_mm_andnot_pd(signMask, _mm_sub_pd(x, m)), lim);
+        acc = _mm_add_pd(acc, _mm_and_pd(keep, x));
+        count += __builtin_popcount(_mm_movemask_pd(keep));
+    }
+    double lanes[2];
+    _mm_storeu_pd(lanes, acc);
+    sum += lanes[0] + lanes[1];
+    sumWithinLimitScalar(v + i, n - i, mean, limit, sum, count);
+}
+
+double minSumOfSquares3SSE2(const double *x, const double *y, const double *z, size_t n) {
+    __m128d best = _mm_set1_pd(INFINITY);
+    size_t i = 0;
+    for (; i + 2 <= n; i += 2) {
+        __m128d a = _mm_loadu_pd(x + i), b = _mm_loadu_pd(y + i), c = _mm_loadu_pd(z + i);
+        __m128d ss = _mm_add_pd(_mm_add_pd(_mm_mul_pd(a, a), _mm_mul_pd(b, b)), _mm_mul_pd(c, c));
+        best = _mm_min_pd(best, ss);
+    }
+    double lanes[2];
+    _mm_storeu_pd(lanes, best);
+    return min({ lanes[0], lanes[1], minSumOfSquares3Scalar(x + i, y + i, z + i, n - i) });
+}
+
+void averageConfidence4SSE2(const double *const low[4], const double *const high[4], const double sensor[4],
+                            size_t n, double *out) {
+    const __m128d signMask = _mm_set1_pd(-0.0), half = _mm_set1_pd(0.5), epsilon = _mm_set1_pd(1e-6);
+    const __m128d fifty = _mm_set1_pd(50.0), hundred = _mm_set1_pd(100.0), zero = _mm_setzero_pd();
+    size_t i = 0;
+    for (; i + 2 <= n; i += 2) {
+        __m128d total = _mm_setzero_pd();
+        for (int d = 0; d < 4; ++d) {
+            __m128d lo = _mm_loadu_pd(low[d] + i), hi = _mm_loadu_pd(high[d] + i);
+            __m128d mid = _mm_mul_pd(_mm_add_pd(lo, hi), half);
+            __m128d rangeHalf = _mm_mul_pd(_mm_sub_pd(hi, lo), half);
+            __m128d diff = _mm_andnot_pd(signMask, _mm_sub_pd(_mm_set1_pd(sensor[d]), mid));
+            __m128d conf = _mm_sub_pd(hundred, _mm_mul_pd(_mm_div_pd(diff, _mm_add_pd(rangeHalf, epsilon)), fifty));
+            // max/min return their second operand when one side is NaN, so NaN survives.
+            total = _mm_add_pd(total, _mm_min_pd(hundred, _mm_max_pd(zero, conf)));
+        }
+        _mm_storeu_pd(out + i, _mm_mul_pd(total, _mm_set1_pd(0.25)));
+    }
+    const double *lowTail[4] = { low[0] + i, low[1] + i, low[2] + i, low[3] + i };
+    const double *highTail[4] = { high[0] + i, high[1] + i, high[2] + i, high[3] + i };
+    averageConfidence4Scalar(lowTail, highTail, sensor, n - i, out + i);
+}
+
+const SensorKernels SSE2_KERNELS = {
+    "sse2", sumSSE2, sumSquaredDeviationsSSE2, sumWithinLimitSSE2, minSumOfSquares3SSE2,
+    averageConfidence4SSE2
+};
+
+__attribute__((target("avx2")))
+double horizontalSum(__m256d v) {
+    __m128d pair = _mm_add_pd(_mm256_castpd256_pd128(v), _mm256_extractf128_pd(v, 1));
+    return _mm_cvtsd_f64(_mm_add_sd(pair, _mm_unpackhi_pd(pair, pair)));
+}
+
+__attribute__((target("avx2")))
+double sumAVX2(const double *v, size_t n) {
+    __m256d acc = _mm256_setzero_pd();
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) acc = _mm256_add_pd(acc, _mm256_loadu_pd(v + i));
+    return horizontalSum(acc) + sumScalar(v + i, n - i);
+}
+
+__attribute__((target("avx2")))
+double sumSquaredDeviationsAVX2(const double *v, size_t n, double mean) {
+    __m256d m = _mm256_set1_pd(mean), acc = _mm256_setzero_pd();
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256d d = _mm256_sub_pd(_mm256_loadu_pd(v + i), m);
+        acc = _mm256_add_pd(acc, _mm256_mul_pd(d, d));
+    }
+    return horizontalSum(acc) + sumSquaredDeviationsScalar(v + i, n - i, mean);
+}
+
+__attribute__((target("avx2")))
+void sumWithinLimitAVX2(const double *v, size_t n, double mean, double limit, double &sum, size_t &count) {
+    const __m256d signMask = _mm256_set1_pd(-0.0);
+    __m256d m = _mm256_set1_pd(mean), lim = _mm256_set1_pd(limit), acc = _mm256_setzero_pd();
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256d x = _mm256_loadu_pd(v + i);
+        __m256d keep = _mm256_cmp_pd(_mm256_andnot_pd(signMask, _mm256_sub_pd(x, m)), lim, _CMP_LE_OQ);
+        acc = _mm256_add_pd(acc, _mm256_and_pd(keep, x));
+        count += __builtin_popcount(_mm256_movemask_pd(keep));
+    }
+    sum += horizontalSum(acc);
+    sumWithinLimitScalar(v + i, n - i, mean, limit, sum, count);
+}
+
+__attribute__((target("avx2")))
+double minSumOfSquares3AVX2(const double *x, const double *y, const double *z, size_t n) {
+    __m256d best = _mm256_set1_pd(INFINITY);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256d a = _mm256_loadu_pd(x + i), b = _mm256_loadu_pd(y + i), c = _mm256_loadu_pd(z + i);
+        __m256d ss = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(a, a), _mm256_mul_pd(b, b)), _mm256_mul_pd(c, c));
+        best = _mm256_min_pd(best, ss);
+    }
+    double lanes[4];
+    _mm256_storeu_pd(lanes, best);
+    return min({ lanes[0], lanes[1], lanes[2], lanes[3], minSumOfSquares3Scalar(x + i, y + i, z + i, n - i) });
+}
+
+__attribute__((target("avx2")))
+void averageConfidence4AVX2(const double *const low[4], const double *const high[4], const double sensor[4],
+                            size_t n, double *out) {
+    const __m256d signMask = _mm256_set1_pd(-0.0), half = _mm256_set1_pd(0.5), epsilon = _mm256_set1_pd(1e-6);
+    const __m256d fifty = _mm256_set1_pd(50.0), hundred = _mm256_set1_pd(100.0), zero = _mm256_setzero_pd();
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256d total = _mm256_setzero_pd();
+        for (int d = 0; d < 4; ++d) {
+            __m256d lo = _mm256_loadu_pd(low[d] + i), hi = _mm256_loadu_pd(high[d] + i);
+            __m256d mid = _mm256_mul_pd(_mm256_add_pd(lo, hi), half);
+            __m256d rangeHalf = _mm256_mul_pd(_mm256_sub_pd(hi, lo), half);
+            __m256d diff = _mm256_andnot_pd(signMask, _mm256_sub_pd(_mm256_set1_pd(sensor[d]), mid));
+            __m256d conf = _mm256_sub_pd(hundred, _mm256_mul_pd(_mm256_div_pd(diff, _mm256_add_pd(rangeHalf, epsilon)), fifty));
+            total = _mm256_add_pd(total, _mm256_min_pd(hundred, _mm256_max_pd(zero, conf)));
+        }
+        _mm256_storeu_pd(out + i, _mm256_mul_pd(total, _mm256_set1_pd(0.25)));
+    }
+    const double *lowTail[4] = { low[0] + i, low[1] + i, low[2] + i, low[3] + i };
+    const double *highTail[4] = { high[0] + i, high[1] + i, high[2] + i, high[3] + i };
+    averageConfidence4Scalar(lowTail, highTail, sensor, n - i, out + i);
+}
+
+const SensorKernels AVX2_KERNELS = {
+    "avx2", sumAVX2, sumSquaredDeviationsAVX2, sumWithinLimitAVX2, minSumOfSquares3AVX2,
+    averageConfidence4AVX2
+};
+#endif
+
+// The kernel set for this CPU, chosen on first use.
+const SensorKernels &sensorKernels() {
+    static const SensorKernels &chosen = [] () -> const SensorKernels & {
+#if defined(__x86_64__)
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) return AVX2_KERNELS;
+        return SSE2_KERNELS;
+#else
+        return SCALAR_KERNELS;
+#endif
+    }();
+    return chosen;
 }
 
 // ---------------------------
-// Main Process
+// Sensor Data Processing
 // ---------------------------
-int main() {
-    auto start = chrono::high_resolution_clock::now();
-    
-    // Clear OUTPUT_DIR so that only one DOCX and one JPG remain.
-    for (const auto &entry : fs::directory_iterator(OUTPUT_DIR))
-        fs::remove(entry.path());
-    
-    // Read sensor logs.
-    vector<string> heartRateLines = readLogFile(HEART_RATE_LOG);
-    vector<string> motionLines = readLogFile(MOTION_LOG);
-    vector<string> tempLines = readLogFile(TEMP_LOG);
-    
-    // Compute sensor values.
-    auto [avgBPM, avgSpO2] = computeHeartRateAverages(heartRateLines);
-    double bestMotion = computeBestMotionValue(motionLines);
-    auto [avgAmbient, avgObject] = computeTemperatureAverages(tempLines);
-    
-    // Candidate selection.
-    vector<pair<string, double>> topCoreWords = selectTopCandidates(CORE_WORDS_DIR, avgAmbient, 10, "word");
-    vector<pair<string, double>> topCoreEmotions = selectTopCandidates(CORE_EMOTIONS_DIR, avgBPM, 10, "emotion");
-    pair<string, double> bestBodyLanguage = selectBestBodyLanguage(BODY_LANGUAGE_DIR, bestMotion);
-    
-    // Error stacking.
-    vector<pair<string,int>> errors;
-    if (topCoreWords.empty()) errors.push_back({"NO CORE WORDS DETECTED", ERR_NO_CORE_WORDS});
-    if (topCoreEmotions.empty()) errors.push_back({"NO CORE EMOTIONS DETECTED", ERR_NO_CORE_EMOTIONS});
-    if (bestBodyLanguage.first.empty()) errors.push_back({"NO BODY LANGUAGE DETECTED", ERR_NO_BODY_LANG});
-    if (!isCameraDetected()) errors.push_back({"USB CAMERA NOT DETECTED", ERR_NO_CAMERA});
-    
-    // Build DOCX content in Markdown.
-    ostringstream docContent;
-    docContent << "# State Profile\n\n";
-    docContent << "## Core Words:\n";
-    for (const auto &cw : topCoreWords)
-        docContent << "- " << cw.first << " [" << fixed << setprecision(3) << cw.second << "%]\n";
-    docContent << "\n## Core Emotions:\n";
-    for (const auto &ce : topCoreEmotions)
-        docContent << "- " << ce.first << " [" << fixed << setprecision(3) << ce.second << "%]\n";
-    docContent << "\n## Body Language:\n- " << bestBodyLanguage.first << " [" << fixed << setprecision(3) << bestBodyLanguage.second << "%]\n\n";
-    docContent << "## Prompt for Gemini:\n";
-    docContent << "Based on the following, formulate a natural sentence for a fuckin cat to say!!! "
-                  "It’s critical that the sentence sounds natural and flows seamlessly—avoid being overly long. "
-                  "Incorporate context from the attached images and sensor data.\n\n";
-    docContent << "Avoid robotic or forced phrasing. The sentence should be concise yet reflective of the cat's current state. "
-                  "Use the nouns in the image for context.\n\n";
-    docContent << "## Attached:\n- Screenshot of /home/m30w/log.txt\n\n";
-    docContent << "## Sensor Summary:\n";
-    docContent << "- Average Heart Rate: " << avgBPM << " BPM, Average SpO2: " << avgSpO2 << "\n";
-    docContent << "- Median Ambient Temp: " << avgAmbient << " C, Median Object Temp: " << avgObject << " C\n";
-    docContent << "- Best Motion (RMS of Gyro): " << bestMotion << "\n";
-    // Append entire log.txt in small font at the bottom.
-    string logText = readFileContents(LOG_FILE);
-    if (logText.empty()) logText = "No log data available.";
-    docContent << "\n## Log File Contents (small print):\n<small>" << logText << "</small>\n";
-    
-    // Define final file paths.
-    string finalDocx = OUTPUT_DIR + "state_profile.docx";
-    string finalImg = FINAL_IMG_NAME;
-    
-    // Capture USB camera snapshot.
-    if (isCameraDetected()) {
-        system(("fswebcam -r 640x480 --jpeg 85 -D 1 " + CAMERA_IMAGE).c_str());
+// 1. Heart Rate: moving average with Z-score outlier removal.
+// Mean and variance are accumulated online with Welford's method, so the first pass needs
+// no sample storage. Partial results from separate chunks are combined with Chan's formula.
+struct RunningStats {
+    size_t count = 0;
+    double mean = 0.0;
+    double m2 = 0.0; // Sum of squared deviations from the running mean.
+
+    void add(double x) {
+        ++count;
+        double delta = x - mean;
+        mean += delta / count;
+        m2 += delta * (x - mean);
     }
-    
-    // Create the DOCX file (directly from Markdown content).
-    createDocxDirectly(finalDocx, docContent.str());
-    
-    // Create a log screenshot.
-    createLogScreenshot();
-    
-    // Convert the DOCX file to JPG using our optimized pipeline.
-    convertDocxToJpg(finalDocx, finalImg);
-    
-    auto end = chrono::high_resolution_clock::now();
-    auto duration = chrono::duration_cast<chrono::milliseconds>(end - start).count();
-    
-    cout << "State profile generated in " << duration << "ms.\n";
-    cout << "DOCX: " << finalDocx << "\nJPG: " << finalImg << "\n";
-    
-    if (!errors.empty()) {
-        cout << "\nErrors Detected:\n";
-        for (const auto &err : errors)
-            cout << err.first << " [Code: " << err.second << "]\n";
+
+    void merge(const RunningStats &other) {
+        if (other.count == 0) return;
+        size_t total = count + other.count;
+        double delta = other.mean - mean;
+        mean += delta * other.count / total;
+        m2 += other.m2 + delta * delta * (double(count) * other.count / total);
+        count = total;
     }
-    
-    return 0;
+
+    // Fold in a whole block at once: its own mean and squared deviations come from the
+    // vector kernels, then the block is merged like any other partial.
+    void addBlock(const double *v, size_t n) {
+        if (n == 0) return;
+        const SensorKernels &k = sensorKernels();
+        RunningStats block;
+        block.count = n;
+        block.mean = k.sum(v, n) / n;
+        block.m2 = k.sumSquaredDeviations(v, n, block.mean);
+        merge(block);
+    }
+
+    double stddev() const { return count ? sqrt(m2 / count) : 0.0; }
+};
+
+// Sum and count of the samples that survive the outlier filter.
+struct KeptSum {
+    double sum = 0.0;
+    size_t count = 0;
+
+    void keepBlock(const double *v, size_t n, double mean, double limit) {
+        sensorKernels().sumWithinLimit(v, n, mean, limit, sum, count);
+    }
+};
+
+// Both passes over a log made of 'chunkCount' chunks. forEachBlock(c, flush) hands every
+// SoA block of (BPM, SpO2) in chunk c to 'flush'; it is called once per chunk and pass.
+template<typename ForEachBlock>
+pair<double, double> heartRateAveragesFromBlocks(size_t chunkCount, ForEachBlock forEachBlock) {
+    // Pass 1: mean and standard deviation.
+    vector<pair<RunningStats, RunningStats>> partials = runChunks(chunkCount, [&](size_t c) {
+        pair<RunningStats, RunningStats> stats;
+        forEachBlock(c, [&](const SampleBlock<2> &block) {
+            stats.first.addBlock(block.column[0], block.size);
+            stats.second.addBlock(block.column[1], block.size);
+        });
+        return stats;
+    });
+    RunningStats bpmStats, spo2Stats;
+    for (const auto &partial : partials) {
+        bpmStats.merge(partial.first);
+        spo2Stats.merge(partial.second);
+    }
+    if (bpmStats.count == 0) return {NAN, NAN};
+    double meanBPM = bpmStats.mean, meanSpO2 = spo2Stats.mean;
+    double limitBPM = 2 * bpmStats.stddev(), limitSpO2 = 2 * spo2Stats.stddev();
+
+    // Pass 2: 2-sigma filter. The samples are re-parsed from the mapped log instead of being
+    // kept in memory, so memory use stays constant however long the log grows.
+    vector<pair<KeptSum, KeptSum>> kept = runChunks(chunkCount, [&](size_t c) {
+        pair<KeptSum, KeptSum> k;
+        forEachBlock(c, [&](const SampleBlock<2> &block) {
+            k.first.keepBlock(block.column[0], block.size, meanBPM, limitBPM);
+            k.second.keepBlock(block.column[1], block.size, meanSpO2, limitSpO2);
+        });
+        return k;
+    });
+    KeptSum keptBPM, keptSpO2;
+    for (const auto &k : kept) {
+        keptBPM.sum += k.first.sum;
+        keptBPM.count += k.first.count;
+        keptSpO2.sum += k.second.sum;
+        keptSpO2.count += k.second.count;
+    }
+    double finalBPM = keptBPM.count == 0 ? meanBPM : keptBPM.sum / keptBPM.count;
+    double finalSpO2 = keptSpO2.count == 0 ? meanSpO2 : keptSpO2.sum / keptSpO2.count;
+    return {finalBPM, finalSpO2};
+}
+
+pair<double, double> computeHeartRateAverages(string_view log) {
+    vector<string_view> slices = splitIntoLineChunks(log, chunkCountFor(log.size(), MIN_BYTES_PER_CHUNK));
+
+    // Parse one chunk into SoA blocks of (BPM, SpO2) and hand every block to 'flush'.
+    return heartRateAveragesFromBlocks(slices.size(), [&](size_t c, auto flush) {
+        SampleBlock<2> block;
+        forEachLine(slices[c], [&](string_view line) {
+            size_t i = block.size;
+            if (parseHeartRateLine(line, block.column[0][i], block.column[1][i]) && ++block.size == SAMPLE_BLOCK_SIZE) {
+                flush(block);
+                block.size = 0;
+            }
+        });
+        flush(block);
+    });
+}
+
+// 2. Temperature: median filtering.
+// Exact mode selects the middle element with nth_element (linear on average) instead of
+// sorting. Streaming mode instead feeds every sample through a P-square quantile estimator
+// (Jain & Chlamtac), which tracks the median online in five markers of constant memory.
+class P2Quantile {
+public:
+    explicit P2Quantile(double quantile) : p(quantile) {}
+
+    void add(double x) {
+        if (n < 5) {
+            height[n++] = x;
+            if (n == 5) {
+                sort(height, height + 5);
+                for (int i = 0; i < 5; ++i) position[i] = i + 1;
+                double init[5] = { 1, 1 + 2 * p, 1 + 4 * p, 3 + 2 * p, 5 };
+                double step[5] = { 0, p / 2, p, (1 + p) / 2, 1 };
+                copy(init, init + 5, desired);
+                copy(step, step + 5, increment);
+            }
+            return;
+        }
+        ++n;
+
+        // Find the cell k with height[k] <= x < height[k + 1], stretching the extremes if needed.
+        int k;
+        if (x < height[0]) {
+            height[0] = x;
+            k = 0;
+        } else if (x >= height[4]) {
+            height[4] = x;
+            k = 3;
+        } else {
+            k = 0;
+            while (x >= height[k + 1]) ++k;
+        }
+        for (int i = k + 1; i < 5; ++i) position[i] += 1;
+        for (int i = 0; i < 5; ++i) desired[i] += increment[i];
+
+        // Nudge the three middle markers towards their desired positions.
+        for (int i = 1; i <= 3; ++i) {
+            double d = desired[i] - position[i];
+            if ((d >= 1 && position[i + 1] - position[i] > 1) || (d <= -1 && position[i - 1] - position[i] < -1)) {
+                int s = d >= 0 ? 1 : -1;
+                double candidate = parabolic(i, s);
+                if (height[i - 1] < candidate && candidate < height[i + 1])
+                    height[i] = candidate;
+                else
+                    height[i] += s * (height[i + s] - height[i]) / (position[i + s] - position[i]);
+                position[i] += s;
+            }
+        }
+    }
+
+    double value() const {
+        if (n == 0) return NAN;
+        if (n >= 5) return height[2];
+        // Too few samples for the markers yet: answer exactly.
+        double few[5];
+        copy(height, height + n, few);
+        sort(few, few + n);
+        return few[size_t(p * n)];
+    }
+
+private:
+    double parabolic(int i, int s) const {
+        return height[i] + s / (position[i + 1] - position[i - 1])
+            * ((position[i] - position[i - 1] + s) * (height[i + 1] - height[i]) / (position[i + 1] - position[i])
+             + (position[i + 1] - position[i] - s) * (height[i] - height[i - 1]) / (position[i] - position[i - 1]));
+    }
+
+    double p;
+    size_t n = 0;
+    double height[5] {};
+    double position[5] {};
+    double desired[5] {};
+    double increment[5] {};
+};
+
+// Upper median, the same element a full sort would leave at size() / 2.
+double selectMedian(vector<double> &values) {
+    auto middle = values.begin() + values.size() / 2;
+    nth_element(values.begin(), middle, values.end());
+    return *middle;
+}
+
+// Exact (ambient, object) medians of per-chunk samples.
+pair<double, double> mediansOfChunks(const vector<pair<vector<double>, vector<double>>> &chunks) {
+    // A median is not mergeable from partial medians, so the chunks are concatenated.
+    vector<double> ambients, objects;
+    for (const auto &chunk : chunks) {
+        ambients.insert(ambients.end(), chunk.first.begin(), chunk.first.end());
+        objects.insert(objects.end(), chunk.second.begin(), chunk.second.end());
+    }
+    if (ambients.empty() || objects.empty()) return {NAN, NAN};
+    return {selectMedian(ambients), selectMedian(objects)};
+}
+
+pair<double, double> computeTemperatureAverages(string_view log, bool streamingMedian = false) {
+    if (streamingMedian) {
+        // P-square markers are not mergeable across chunks, so this is one sequential pass.
+        P2Quantile ambientMedian(0.5), objectMedian(0.5);
+        forEachLine(log, [&](string_view line) {
+            double ambient = 0.0, objectT = 0.0;
+            if (parseTemperatureLine(line, ambient, objectT)) {
+                ambientMedian.add(ambient);
+                objectMedian.add(objectT);
+            }
+        });
+        return {ambientMedian.value(), objectMedian.value()};
+    }
+
+    vector<string_view> slices = splitIntoLineChunks(log, chunkCountFor(log.size(), MIN_BYTES_PER_CHUNK));
+    vector<pair<vector<double>, vector<double>>> chunks = runChunks(slices.size(), [&](size_t c) {
+        pair<vector<double>, vector<double>> chunk;
+        forEachLine(slices[c], [&](string_view line) {
+            double ambient = 0.0, objectT = 0.0;
+            if (parseTemperatureLine(line, ambient, objectT)) {
+                chunk.first.push_back(ambient);
+                chunk.second.push_back(objectT);
+            }
+        });
+        return chunk;
+    });
+    return mediansOfChunks(chunks);
+}
+
+// 3. Motion: compute RMS of gyroscope values and choose the minimum RMS.
+// sqrt(s / 3) grows with s, so the block kernels only track the smallest gx^2 + gy^2 + gz^2
+// and the square root is taken once at the end.
+double computeBestMotionValue(string_view log) {
+    vector<string_view> slices = splitIntoLineChunks(log, chunkCountFor(log.size(), MIN_BYTES_PER_CHUNK));
+    vector<double> chunkBest = runChunks(slices.size(), [&](size_t c) {
+        double best = INFINITY;
+        SampleBlock<3> gyro;
+        auto flush = [&] {
+            best = min(best, sensorKernels().minSumOfSquares3(gyro.column[0], gyro.column[1], gyro.column[2], gyro.size));
+            gyro.size = 0;
+        };
+        forEachLine(slices[c], [&](string_view line) {
+            double ax, ay, az;
+            size_t i = gyro.size;
+            if (parseMotionLine(line, ax, ay, az, gyro.column[0][i], gyro.column[1][i], gyro.column[2][i])
+                && ++gyro.size == SAMPLE_BLOCK_SIZE)
+                flush();
+        });
+        flush();
+        return best;
+    });
+    double best = *min_element(chunkBest.begin(), chunkBest.end());
+    return isinf(best) ? NAN : sqrt(best / 3.0);
+}
+
+// ---------------------------
+// Binary Sensor Logs
+// ---------------------------
+// Compact alternative to the text logs. Each sensor has its own file of fixed-size records,
+// a millisecond timestamp followed by the sensor's fields as doubles, grouped into blocks of
+// up to SAMPLE_BLOCK_SIZE records that are zlib-compressed one by one. Layout, native-endian:
+//   file header | block header | compressed block | block header | compressed block | ...
+// Inside a block the timestamps come first and then one column per field, so a decoded block
+// drops straight into a SampleBlock. The block headers carry the time range of their records
+// and form the block index that time seeks use; a reader collects them when it opens the log,
+// which touches one header per block and decompresses nothing.
+// The daemon appends every sample it tails (see SensorArchive). Once the live file grows past
+// BINARY_LOG_ROTATE_BYTES it becomes "<path>.1" (older files move up to .2, .3, ...) and a new
+// file is started. Readers see all of them as one log.
+enum class SensorKind : uint32_t { HeartRate = 1, Temperature = 2, Motion = 3 };
+
+// Fields per record, in the order the text log lists them.
+int sensorFieldCount(SensorKind kind) {
+    switch (kind) {
+    case SensorKind::HeartRate: return 2;   // BPM, SpO2
+    case SensorKind::Temperature: return 2; // ambient, object
+    case SensorKind::Motion: return 6;      // accel x/y/z, gyro x/y/z
+    }
+    return 0;
+}
+
+const int MAX_SENSOR_FIELDS = 6;
+const char BINARY_LOG_MAGIC[4] = { 'S', 'P', 'B', 'L' };
+const uint32_t BINARY_LOG_VERSION = 1;
+const uint64_t BINARY_LOG_ROTATE_BYTES = 64ull << 20;
+const int BINARY_LOG_KEEP_FILES = 4; // Rotated files kept besides the live one.
+
+struct BinaryLogFileHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t kind;
+    uint32_t fieldCount;
+};
+
+struct BinaryLogBlockHeader {
+    int64_t firstTimestampMs;
+    int64_t lastTimestampMs;
+    uint32_t recordCount;
+    uint32_t rawBytes;
+    uint32_t compressedBytes;
+    uint32_t checksum; // CRC-32 of the compressed bytes.
+};
+
+// "heart_rate.txt" -> "heart_rate.bin"
+string binaryLogPath(const string &textPath) {
+    return fs::path(textPath).replace_extension(".bin").string();
+}
+
+// File 'generation' of a rotated log; generation 0 is the live file.
+string rotatedLogPath(const string &path, int generation) {
+    return generation == 0 ? path : path + "." + to_string(generation);
+}
+
+// One entry of the block index.
+struct BinaryLogBlock {
+    const char *data; // Compressed bytes, inside the mapping of their file.
+    uint32_t compressedBytes;
+    uint32_t recordCount;
+    uint32_t checksum;
+    int64_t firstTimestampMs;
+    int64_t lastTimestampMs;
+};
+
+// Walk the block headers of one file image, appending them to 'blocks' if given. Returns the
+// length of the well-formed prefix, or 0 if the file header doesn't match 'kind'. Bytes past
+// that prefix are a block cut short by a crash in the middle of a write.
+size_t scanBinaryLog(string_view bytes, SensorKind kind, vector<BinaryLogBlock> *blocks) {
+    BinaryLogFileHeader header;
+    if (bytes.size() < sizeof header) return 0;
+    memcpy(&header, bytes.data(), sizeof header);
+    if (memcmp(header.magic, BINARY_LOG_MAGIC, sizeof header.magic) != 0 || header.version != BINARY_LOG_VERSION
+        || header.kind != uint32_t(kind) || int(header.fieldCount) != sensorFieldCount(kind))
+        return 0;
+    size_t recordBytes = sizeof(int64_t) + header.fieldCount * sizeof(double);
+    size_t pos = sizeof header;
+    while (bytes.size() - pos >= sizeof(BinaryLogBlockHeader)) {
+        BinaryLogBlockHeader block;
+        memcpy(&block, bytes.data() + pos, sizeof block);
+        if (block.recordCount == 0 || block.recordCount > SAMPLE_BLOCK_SIZE
+            || block.rawBytes != block.recordCount * recordBytes
+            || bytes.size() - pos - sizeof block < block.compressedBytes)
+            break;
+        if (blocks)
+            blocks->push_back({ bytes.data() + pos + sizeof block, block.compressedBytes, block.recordCount,
+                                block.checksum, block.firstTimestampMs, block.lastTimestampMs });
+        pos += sizeof block + block.compressedBytes;
+    }
+    return pos;
+}
+
+// Appends records to a binary log, one compressed block per SAMPLE_BLOCK_SIZE records.
+// Records still buffered are written by flush() and by the destructor.
+class BinaryLogWriter {
+public:
+    // A 'rotateBytes' of 0 never rotates.
+    BinaryLogWriter(string logPath, SensorKind sensorKind, uint64_t rotateBytes = BINARY_LOG_ROTATE_BYTES)
+        : path(move(logPath)), kind(sensorKind), fields(sensorFieldCount(sensorKind)), rotateAt(rotateBytes),
+          values(fields * SAMPLE_BLOCK_SIZE) {
+        timestamps.reserve(SAMPLE_BLOCK_SIZE);
+        healthy = open();
+    }
+    ~BinaryLogWriter() { flush(); }
+    BinaryLogWriter(const BinaryLogWriter &) = delete;
+    BinaryLogWriter &operator=(const BinaryLogWriter &) = delete;
+
+    bool ok() const { return healthy; }
+    // True while the live file holds no blocks and none are buffered.
+    bool empty() const { return fileBytes <= sizeof(BinaryLogFileHeader) && timestamps.empty(); }
+
+    // Add one record; 'record' holds sensorFieldCount() values.
+    bool append(int64_t timestampMs, const double *record) {
+        if (!healthy) return false;
+        size_t i = timestamps.size();
+        timestamps.push_back(timestampMs);
+        for (int f = 0; f < fields; ++f)
+            values[f * SAMPLE_BLOCK_SIZE + i] = record[f];
+        return timestamps.size() < SAMPLE_BLOCK_SIZE || flush();
+    }
+
+    // Compress the buffered records and write them out as one block.
+    bool flush() {
+        if (!healthy || timestamps.empty()) return healthy;
+        size_t n = timestamps.size();
+        raw.resize(n * (sizeof(int64_t) + fields * sizeof(double)));
+        char *p = raw.data();
+        memcpy(p, timestamps.data(), n * sizeof(int64_t));
+        p += n * sizeof(int64_t);
+        for (int f = 0; f < fields; ++f, p += n * sizeof(double))
+            memcpy(p, &values[f * SAMPLE_BLOCK_SIZE], n * sizeof(double));
+
+        uLongf compressedSize = compressBound(raw.size());
+        compressed.resize(compressedSize);
+        if (compress2(reinterpret_cast<Bytef *>(compressed.data()), &compressedSize,
+                      reinterpret_cast<const Bytef *>(raw.data()), raw.size(), Z_DEFAULT_COMPRESSION) != Z_OK) {
+            cerr << "Error: Could not compress a block of " << path << endl;
+            return healthy = false;
+        }
+        auto [earliest, latest] = minmax_element(timestamps.begin(), timestamps.end());
+        BinaryLogBlockHeader header = {
+            *earliest, *latest, uint32_t(n), uint32_t(raw.size()), uint32_t(compressedSize),
+            uint32_t(crc32(0L, reinterpret_cast<const Bytef *>(compressed.data()), compressedSize))
+        };
+        timestamps.clear();
+
+        uint64_t blockBytes = sizeof header + compressedSize;
+        if (rotateAt > 0 && fileBytes > sizeof(BinaryLogFileHeader) && fileBytes + blockBytes > rotateAt && !rotate())
+            return false;
+        out.write(reinterpret_cast<const char *>(&header), sizeof header);
+        out.write(compressed.data(), compressedSize);
+        out.flush();
+        if (!out) {
+            cerr << "Error: Could not write to " << path << endl;
+            return healthy = false;
+        }
+        fileBytes += blockBytes;
+        return true;
+    }
+
+private:
+    // Open the live file for appending, starting it if it is new, empty or cut off inside its
+    // header by a crash.
+    bool open() {
+        error_code ec;
+        uintmax_t size = fs::file_size(path, ec);
+        if (ec) size = 0;
+        if (size > 0 && size < sizeof(BinaryLogFileHeader)) {
+            fs::resize_file(path, 0, ec);
+            if (ec) {
+                cerr << "Error: Could not truncate " << path << ": " << ec.message() << endl;
+                return false;
+            }
+            size = 0;
+        }
+        if (size > 0) {
+            size_t valid = scanBinaryLog(MappedFile(path).text(), kind, nullptr);
+            if (valid == 0) {
+                cerr << "Error: " << path << " is not a binary log of this sensor." << endl;
+                return false;
+            }
+            if (valid < size) fs::resize_file(path, valid, ec); // Drop a torn last block.
+            size = valid;
+        }
+        out.open(path, ios::binary | ios::app);
+        if (!out) {
+            cerr << "Error: Could not open " << path << " for writing." << endl;
+            return false;
+        }
+        if (size == 0) {
+            BinaryLogFileHeader header = { {}, BINARY_LOG_VERSION, uint32_t(kind), uint32_t(fields) };
+            memcpy(header.magic, BINARY_LOG_MAGIC, sizeof header.magic);
+            out.write(reinterpret_cast<const char *>(&header), sizeof header);
+            size = sizeof header;
+        }
+        fileBytes = size;
+        return true;
+    }
+
+    // Shift every file up one generation, dropping the oldest, and start a new live file.
+    bool rotate() {
+        out.close();
+        error_code ec; // Missing generations are fine.
+        fs::remove(rotatedLogPath(path, BINARY_LOG_KEEP_FILES), ec);
+        for (int g = BINARY_LOG_KEEP_FILES - 1; g >= 0; --g)
+            fs::rename(rotatedLogPath(path, g), rotatedLogPath(path, g + 1), ec);
+        return healthy = open();
+    }
+
+    string path;
+    SensorKind kind;
+    int fields;
+    uint64_t rotateAt;
+    ofstream out;
+    uint64_t fileBytes = 0;
+    bool healthy = false;
+    vector<int64_t> timestamps; // Buffered records, column by column.
+    vector<double> values;
+    vector<char> raw, compressed;
+};
+
+// Maps a binary log and its rotated files, oldest first, and decodes blocks on request.
+// Blocks are independent, so different threads may decode different blocks at once.
+class BinaryLogReader {
+public:
+    BinaryLogReader(const string &path, SensorKind sensorKind) : kind(sensorKind) {
+        for (int g = BINARY_LOG_KEEP_FILES; g >= 0; --g) {
+            string file = rotatedLogPath(path, g);
+            if (!fileExists(file)) continue;
+            // Moving a MappedFile keeps its mapping, so the block pointers stay valid.
+            files.emplace_back(file);
+            scanBinaryLog(files.back().text(), kind, &blocks);
+        }
+    }
+
+    size_t blockCount() const { return blocks.size(); }
+    const BinaryLogBlock &block(size_t i) const { return blocks[i]; }
+
+    // Index of the first block that may hold records at or after 'timestampMs'; blocks are
+    // in the order they were written, which for a live sensor is time order.
+    size_t seek(int64_t timestampMs) const {
+        return partition_point(blocks.begin(), blocks.end(),
+                               [&](const BinaryLogBlock &b) { return b.lastTimestampMs < timestampMs; })
+            - blocks.begin();
+    }
+
+    // Decode block 'i' into 'out', whose Fields must match the sensor, and its timestamps into
+    // 'timestamps' if given. A damaged block is reported and skipped by returning false.
+    template<int Fields>
+    bool readBlock(size_t i, SampleBlock<Fields> &out, int64_t *timestamps = nullptr) const {
+        static_assert(Fields <= MAX_SENSOR_FIELDS, "more fields than any sensor has");
+        const BinaryLogBlock &b = blocks[i];
+        size_t n = b.recordCount;
+        thread_local vector<char> raw;
+        uLongf rawSize = n * (sizeof(int64_t) + Fields * sizeof(double));
+        raw.resize(rawSize);
+        if (Fields != sensorFieldCount(kind)
+            || crc32(0L, reinterpret_cast<const Bytef *>(b.data), b.compressedBytes) != b.checksum
+            || uncompress(reinterpret_cast<Bytef *>(raw.data()), &rawSize,
+                          reinterpret_cast<const Bytef *>(b.data), b.compressedBytes) != Z_OK
+            || rawSize != raw.size()) {
+            cerr << "Warning: Skipping damaged block " << i << " of a binary sensor log." << endl;
+            return false;
+        }
+        const char *p = raw.data();
+        if (timestamps) memcpy(timestamps, p, n * sizeof(int64_t));
+        p += n * sizeof(int64_t);
+        for (int f = 0; f < Fields; ++f, p += n * sizeof(double))
+            memcpy(out.column[f], p, n * sizeof(double));
+        out.size = n;
+        return true;
+    }
+
+private:
+    SensorKind kind;
+    vector<MappedFile> files;
+    vector<BinaryLogBlock> blocks;
+};
+
+// Decoding a block is far cheaper than parsing its text, so chunks are counted in blocks.
+const size_t MIN_BLOCKS_PER_CHUNK = 64;
+
+// Call fn(block) for every intact block of chunk 'c' out of 'chunkCount'.
+template<int Fields, typename Fn>
+void forEachBinaryBlock(const BinaryLogReader &log, size_t chunkCount, size_t c, Fn fn) {
+    auto [begin, end] = chunkBounds(log.blockCount(), chunkCount, c);
+    SampleBlock<Fields> block;
+    for (size_t i = begin; i < end; ++i)
+        if (log.readBlock(i, block)) fn(block);
+}
+
+pair<double, double> computeHeartRateAverages(const BinaryLogReader &log) {
+    size_t chunkCount = chunkCountFor(log.blockCount(), MIN_BLOCKS_PER_CHUNK);
+    return heartRateAveragesFromBlocks(chunkCount, [&](size_t c, auto flush) {
+        forEachBinaryBlock<2>(log, chunkCount, c, flush);
+    });
+}
+
+pair<double, double> computeTemperatureAverages(const BinaryLogReader &log, bool streamingMedian = false) {
+    if (streamingMedian) {
+        P2Quantile ambientMedian(0.5), objectMedian(0.5);
+        forEachBinaryBlock<2>(log, 1, 0, [&](const SampleBlock<2> &block) {
+            for (size_t i = 0; i < block.size; ++i) {
+                ambientMedian.add(block.column[0][i]);
+                objectMedian.add(block.column[1][i]);
+            }
+        });
+        return {ambientMedian.value(), objectMedian.value()};
+    }
+
+    size_t chunkCount = chunkCountFor(log.blockCount(), MIN_BLOCKS_PER_CHUNK);
+    vector<pair<vector<double>, vector<double>>> chunks = runChunks(chunkCount, [&](size_t c) {
+        pair<vector<double>, vector<double>> chunk;
+        forEachBinaryBlock<2>(log, chunkCount, c, [&](const SampleBlock<2> &block) {
+            chunk.first.insert(chunk.first.end(), block.column[0], block.column[0] + block.size);
+            chunk.second.insert(chunk.second.end(), block.column[1], block.column[1] + block.size);
+        });
+        return chunk;
+    });
+    return mediansOfChunks(chunks);
+}
+
+double computeBestMotionValue(const BinaryLogReader &log) {
+    size_t chunkCount = chunkCountFor(log.blockCount(), MIN_BLOCKS_PER_CHUNK);
+    vector<double> chunkBest = runChunks(chunkCount, [&](size_t c) {
+        double best = INFINITY;
+        forEachBinaryBlock<6>(log, chunkCount, c, [&](const SampleBlock<6> &block) {
+            best = min(best, sensorKernels().minSumOfSquares3(block.column[3], block.column[4], block.column[5], block.size));
+        });
+        return best;
+    });
+    double best = *min_element(chunkBest.begin(), chunkBest.end());
+    return isinf(best) ? NAN : sqrt(best / 3.0);
+}
+
+int64_t modificationTimeMs(const struct stat &st) {
+    return int64_t(st.st_mtim.tv_sec) * 1000 + st.st_mtim.tv_nsec / 1000000;
+}
+
+// Rewrite a text log as the binary log next to it, replacing any earlier one and its rotated
+// files. The text logs carry no timestamps, so every record gets the text log's mtime. Not for
+// use while a daemon is appending to the binary logs.
+bool convertTextLogToBinary(const string &textPath, SensorKind kind, bool verbose = true) {
+    struct stat st;
+    if (stat(textPath.c_str(), &st) != 0) {
+        cerr << "Error: Could not read " << textPath << endl;
+        return false;
+    }
+    int64_t timestampMs = modificationTimeMs(st);
+
+    string binPath = binaryLogPath(textPath);
+    string tmpPath = binPath + tempSuffix();
+    error_code ec;
+    fs::remove(tmpPath, ec);
+    size_t records = 0;
+    bool ok;
+    {
+        BinaryLogWriter writer(tmpPath, kind, 0);
+        ok = writer.ok();
+        double r[MAX_SENSOR_FIELDS];
+        string text;
+        forEachLine(readLogSnapshot(textPath, text), [&](string_view line) {
+            bool parsed = kind == SensorKind::HeartRate ? parseHeartRateLine(line, r[0], r[1])
+                        : kind == SensorKind::Temperature ? parseTemperatureLine(line, r[0], r[1])
+                        : parseMotionLine(line, r[0], r[1], r[2], r[3], r[4], r[5]);
+            if (parsed && ok) {
+                ok = writer.append(timestampMs, r);
+                ++records;
+            }
+        });
+        ok = ok && writer.flush();
+    }
+    if (!ok) {
+        fs::remove(tmpPath, ec);
+        return false;
+    }
+    fs::rename(tmpPath, binPath, ec);
+    if (ec) {
+        cerr << "Error: Could not replace " << binPath << ": " << ec.message() << endl;
+        fs::remove(tmpPath, ec);
+        return false;
+    }
+    for (int g = 1; g <= BINARY_LOG_KEEP_FILES; ++g)
+        fs::remove(rotatedLogPath(binPath, g), ec);
+    if (verbose)
+        cout << textPath << " -> " << binPath << ": " << records << " records, "
+             << fs::file_size(binPath, ec) << " bytes" << endl;
+    return true;
+}
+
+// Read the binary log instead of 'textPath' when it exists and is not older than the text
+// log. A running daemon keeps it that way; a text log that grew while no daemon ran still wins.
+bool preferBinaryLog(const string &textPath) {
+    error_code binError, textError;
+    auto binTime = fs::last_write_time(binaryLogPath(textPath), binError);
+    auto textTime = fs::last_write_time(textPath, textError);
+    return !binError && (textError || binTime >= textTime);
+}
+
+// Each of these is timed as one span, reading the log included.
+pair<double, double> heartRateFromLog(const string &textPath) {
+    if (preferBinaryLog(textPath)) {
+        ScopedTimer timer("parse: heart rate (binary)");
+        return computeHeartRateAverages(BinaryLogReader(binaryLogPath(textPath), SensorKind::HeartRate));
+    }
+    ScopedTimer timer("parse: heart rate (text)");
+    string text;
+    return computeHeartRateAverages(readLogSnapshot(textPath, text));
+}
+
+pair<double, double> temperatureFromLog(const string &textPath, bool streamingMedian) {
+    if (preferBinaryLog(textPath)) {
+        ScopedTimer timer("parse: temperature (binary)");
+        return computeTemperatureAverages(BinaryLogReader(binaryLogPath(textPath), SensorKind::Temperature), streamingMedian);
+    }
+    ScopedTimer timer("parse: temperature (text)");
+    string text;
+    return computeTemperatureAverages(readLogSnapshot(textPath, text), streamingMedian);
+}
+
+double bestMotionFromLog(const string &textPath) {
+    if (preferBinaryLog(textPath)) {
+        ScopedTimer timer("parse: motion (binary)");
+        return computeBestMotionValue(BinaryLogReader(binaryLogPath(textPath), SensorKind::Motion));
+    }
+    ScopedTimer timer("parse: motion (text)");
+    string text;
+    return computeBestMotionValue(readLogSnapshot(textPath, text));
+}
+
+// ---------------------------
+// Compiled Candidate Index
+// ---------------------------
+// Parsing thousands of candidate JSON files on every run is slow, so each candidate
+// directory is compiled once into a flat binary index and reused until the directory's
+// mtime changes (a file added, removed or renamed). Layout, all native-endian:
+//   header | RANGE_COLUMNS x count doubles | (count + 1) uint64 label offsets
+//          | one range grid per range pair | label bytes
+// The numeric bounds are stored column by column (structure of arrays) so scoring can
+// stream straight through them. The file is memory-mapped when loaded.
+enum RangeColumn {
+    HEART_RATE_LOW, HEART_RATE_HIGH,
+    OBJECT_TEMP_LOW, OBJECT_TEMP_HIGH,
+    AMBIENT_TEMP_LOW, AMBIENT_TEMP_HIGH,
+    SPO2_LOW, SPO2_HIGH,
+    MOTION_LOW, MOTION_HIGH, // motion_values.acceleration_x, used by body language
+    RANGE_COLUMNS
+};
+
+struct CandidateIndexHeader {
+    char magic[4];
+    uint32_t version;
+    int64_t dirMtime;
+    uint64_t count;
+    uint64_t labelBytes;
+    uint64_t gridBytes;
+};
+
+const char CANDIDATE_INDEX_MAGIC[4] = { 'S', 'P', 'C', 'I' };
+const uint32_t CANDIDATE_INDEX_VERSION = 2;
+
+// Size of an index image with 'count' candidates, 'labelBytes' bytes of label text and
+// 'gridBytes' bytes of range grids.
+size_t candidateIndexSize(uint64_t count, uint64_t labelBytes, uint64_t gridBytes) {
+    return sizeof(CandidateIndexHeader) + RANGE_COLUMNS * count * sizeof(double)
+         + (count + 1) * sizeof(uint64_t) + gridBytes + labelBytes;
+}
+
+// Range grids. A candidate range [low, high] gives a confidence above zero only to sensor
+// values less than twice its half-width from its midpoint (see computeConfidence), so
+// that support interval is what gets indexed. Each range pair has a uniform grid over the
+// span of all supports, a few cells to a typical support, and each cell lists the
+// candidates whose support touches it in ascending order. A query reads the one cell its
+// sensor value falls in, plus an overflow list of candidates that could not be placed:
+// supports spanning too many cells, and inverted or non-finite ranges. Per pair:
+//   RangeGridHeader | (cellCount + 2) uint64 list offsets | idCount uint32 ids | padding to 8
+// List c < cellCount is cell c and list cellCount is the overflow list.
+const int RANGE_PAIRS = RANGE_COLUMNS / 2;
+const size_t MAX_GRID_CELLS = 1 << 16;
+const size_t GRID_CELLS_PER_SUPPORT = 4;
+const size_t MAX_CELLS_PER_CANDIDATE = 32;
+
+struct RangeGridHeader {
+    double origin;
+    double cellWidth;
+    uint64_t cellCount;
+    uint64_t idCount;
+};
+
+struct RangeGrid {
+    double origin = 0.0;
+    double cellWidth = 1.0;
+    size_t cellCount = 0;
+    const uint64_t *offsets = nullptr;
+    const uint32_t *ids = nullptr;
+};
+
+size_t rangeGridSize(const RangeGridHeader &header) {
+    size_t idBytes = header.idCount * sizeof(uint32_t);
+    return sizeof(RangeGridHeader) + (header.cellCount + 2) * sizeof(uint64_t) + (idBytes + 7) / 8 * 8;
+}
+
+// Sensor values for which the range [low, high] can score above zero, widened a little so
+// rounding never drops a candidate that scores. Returns false for ranges that cannot be
+// bounded this way.
+bool confidenceSupport(double low, double high, double &from, double &to) {
+    double mid = (low + high) / 2.0;
+    double reach = 2.0 * ((high - low) / 2.0 + 1e-6);
+    if (!isfinite(mid) || !isfinite(reach) || !(reach > 0)) return false;
+    double slack = 1e-9 * (fabs(mid) + reach + 1.0);
+    from = mid - reach - slack;
+    to = mid + reach + slack;
+    return true;
+}
+
+// Grid cell of 'value', or -1 if it falls outside the grid.
+long rangeGridCell(double origin, double cellWidth, size_t cellCount, double value) {
+    double cell = floor((value - origin) / cellWidth);
+    return (cell >= 0 && cell < double(cellCount)) ? long(cell) : -1;
+}
+
+// Build the grid of range pair 'pair' over 'rows' and append it to 'out'.
+void appendRangeGrid(const vector<array<double, RANGE_COLUMNS>> &rows, int pair, vector<char> &out) {
+    size_t n = rows.size();
+    vector<double> from(n), to(n), widths;
+    vector<char> bounded(n);
+    for (size_t i = 0; i < n; ++i) {
+        bounded[i] = confidenceSupport(rows[i][2 * pair], rows[i][2 * pair + 1], from[i], to[i]);
+        if (bounded[i]) widths.push_back(to[i] - from[i]);
+    }
+
+    RangeGridHeader header = { 0.0, 1.0, 1, 0 };
+    if (!widths.empty()) {
+        nth_element(widths.begin(), widths.begin() + widths.size() / 2, widths.end());
+        double cellWidth = widths[widths.size() / 2] / GRID_CELLS_PER_SUPPORT;
+        // Supports much wider than typical go to the overflow list rather than stretch the grid.
+        double lo = INFINITY, hi = -INFINITY;
+        for (size_t i = 0; i < n; ++i) {
+            if (bounded[i] && to[i] - from[i] > cellWidth * (MAX_CELLS_PER_CANDIDATE - 1)) bounded[i] = 0;
+            if (!bounded[i]) continue;
+            lo = min(lo, from[i]);
+            hi = max(hi, to[i]);
+        }
+        double span = hi - lo;
+        if (isfinite(span) && span > 0 && cellWidth > 0) {
+            header.origin = lo;
+            header.cellCount = size_t(clamp(ceil(span / cellWidth), 1.0, double(MAX_GRID_CELLS)));
+            header.cellWidth = span / header.cellCount;
+        } else {
+            fill(bounded.begin(), bounded.end(), 0);
+        }
+    }
+
+    // Lists 0..cellCount-1 are cells, list cellCount is the overflow list.
+    auto cellsOf = [&](size_t i, long &first, long &last) {
+        if (!bounded[i]) return false;
+        first = rangeGridCell(header.origin, header.cellWidth, header.cellCount, from[i]);
+        last = rangeGridCell(header.origin, header.cellWidth, header.cellCount, to[i]);
+        if (first < 0) first = 0;
+        if (last < 0) last = long(header.cellCount) - 1;
+        return size_t(last - first) < MAX_CELLS_PER_CANDIDATE;
+    };
+    vector<uint64_t> offsets(header.cellCount + 2, 0);
+    for (size_t i = 0; i < n; ++i) {
+        long first, last;
+        if (cellsOf(i, first, last)) {
+            for (long c = first; c <= last; ++c) ++offsets[c + 1];
+        } else {
+            ++offsets[header.cellCount + 1];
+        }
+    }
+    partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+    header.idCount = offsets.back();
+    vector<uint32_t> ids(header.idCount);
+    vector<uint64_t> next(offsets.begin(), offsets.end() - 1);
+    for (size_t i = 0; i < n; ++i) {
+        long first, last;
+        if (cellsOf(i, first, last)) {
+            for (long c = first; c <= last; ++c) ids[next[c]++] = uint32_t(i);
+        } else {
+            ids[next[header.cellCount]++] = uint32_t(i);
+        }
+    }
+
+    size_t start = out.size();
+    out.resize(start + rangeGridSize(header), 0);
+    char *p = out.data() + start;
+    memcpy(p, &header, sizeof(header));
+    p += sizeof(header);
+    memcpy(p, offsets.data(), offsets.size() * sizeof(uint64_t));
+    p += offsets.size() * sizeof(uint64_t);
+    memcpy(p, ids.data(), ids.size() * sizeof(uint32_t));
+}
+
+class CandidateIndex {
+public:
+    CandidateIndex() = default;
+
+    // Use an index image that lives in a mapped file...
+    explicit CandidateIndex(MappedFile &&mapped) : file(make_shared<MappedFile>(move(mapped))) {
+        attach(file->text());
+    }
+    // ...or one that was just built in memory.
+    explicit CandidateIndex(vector<char> &&image) : buffer(make_shared<vector<char>>(move(image))) {
+        attach(string_view(buffer->data(), buffer->size()));
+    }
+
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    const double *column(RangeColumn c) const { return columns + c * count; }
+    string_view label(size_t i) const {
+        return string_view(labels + labelOffsets[i], labelOffsets[i + 1] - labelOffsets[i]);
+    }
+
+    // Call fn(i) for every candidate whose range starting at column 'low' may score above
+    // zero for 'value', in ascending order within the grid cell and then the overflow
+    // list. No candidate is visited twice; every candidate that is skipped scores 0.
+    template<typename Fn>
+    void forEachInSupport(RangeColumn low, double value, Fn fn) const {
+        const RangeGrid &grid = grids[low / 2];
+        if (grid.cellCount == 0) return;
+        auto visit = [&](size_t list) {
+            for (uint64_t k = grid.offsets[list]; k < grid.offsets[list + 1]; ++k) fn(size_t(grid.ids[k]));
+        };
+        long cell = rangeGridCell(grid.origin, grid.cellWidth, grid.cellCount, value);
+        if (cell >= 0) visit(size_t(cell));
+        visit(grid.cellCount);
+    }
+
+    // Check that 'image' is a complete index built for a directory with mtime 'dirMtime'.
+    static bool isValidImage(string_view image, int64_t dirMtime) {
+        if (image.size() < sizeof(CandidateIndexHeader)) return false;
+        CandidateIndexHeader header;
+        memcpy(&header, image.data(), sizeof(header));
+        return memcmp(header.magic, CANDIDATE_INDEX_MAGIC, 4) == 0
+            && header.version == CANDIDATE_INDEX_VERSION
+            && header.dirMtime == dirMtime
+            && image.size() == candidateIndexSize(header.count, header.labelBytes, header.gridBytes)
+            && gridsFit(image.data() + image.size() - header.labelBytes - header.gridBytes, header.gridBytes, header.count);
+    }
+
+private:
+    // Check that the grids in the 'gridBytes' bytes at 'p' add up to exactly that size, and
+    // that each one's lists lie within its ids and name only candidates below 'count'.
+    static bool gridsFit(const char *p, uint64_t gridBytes, uint64_t count) {
+        for (int pair = 0; pair < RANGE_PAIRS; ++pair) {
+            RangeGridHeader header;
+            if (gridBytes < sizeof(header)) return false;
+            memcpy(&header, p, sizeof(header));
+            if (header.cellCount == 0 || header.cellCount > MAX_GRID_CELLS || header.idCount > gridBytes
+                || !isfinite(header.origin) || !isfinite(header.cellWidth) || !(header.cellWidth > 0))
+                return false;
+            size_t size = rangeGridSize(header);
+            if (size > gridBytes) return false;
+            const uint64_t *offsets = reinterpret_cast<const uint64_t *>(p + sizeof(header));
+            const uint32_t *ids = reinterpret_cast<const uint32_t *>(offsets + header.cellCount + 2);
+            if (offsets[0] != 0 || offsets[header.cellCount + 1] != header.idCount) return false;
+            for (uint64_t list = 0; list <= header.cellCount; ++list)
+                if (offsets[list] > offsets[list + 1]) return false;
+            for (uint64_t k = 0; k < header.idCount; ++k)
+                if (ids[k] >= count) return false;
+            p += size;
+            gridBytes -= size;
+        }
+        return gridBytes == 0;
+    }
+
+    void attach(string_view image) {
+        CandidateIndexHeader header;
+        memcpy(&header, image.data(), sizeof(header));
+        count = header.count;
+        const char *p = image.data() + sizeof(header);
+        columns = reinterpret_cast<const double *>(p);
+        p += RANGE_COLUMNS * count * sizeof(double);
+        labelOffsets = reinterpret_cast<const uint64_t *>(p);
+        p += (count + 1) * sizeof(uint64_t);
+        for (RangeGrid &grid : grids) {
+            RangeGridHeader gridHeader;
+            memcpy(&gridHeader, p, sizeof(gridHeader));
+            grid.origin = gridHeader.origin;
+            grid.cellWidth = gridHeader.cellWidth;
+            grid.cellCount = gridHeader.cellCount;
+            grid.offsets = reinterpret_cast<const uint64_t *>(p + sizeof(gridHeader));
+            grid.ids = reinterpret_cast<const uint32_t *>(grid.offsets + grid.cellCount + 2);
+            p += rangeGridSize(gridHeader);
+        }
+        labels = p;
+    }
+
+    // Exactly one of these owns the bytes; shared so the index is cheap to copy around.
+    shared_ptr<MappedFile> file;
+    shared_ptr<vector<char>> buffer;
+    size_t count = 0;
+    const double *columns = nullptr;
+    const uint64_t *labelOffsets = nullptr;
+    RangeGrid grids[RANGE_PAIRS];
+    const char *labels = nullptr;
+};
+
+// Directory mtime as a plain integer, or -1 if the directory cannot be read.
+int64_t directoryMtime(const string &dirPath) {
+    error_code ec;
+    auto mtime = fs::last_write_time(dirPath, ec);
+    return ec ? -1 : int64_t(mtime.time_since_epoch().count());
+}
+
+// On-demand reader for candidate files. Candidate JSON is small and flat, and only the label
+// and a few range arrays are needed, so instead of building a Json::Value tree the text is
+// scanned once and everything else is skipped. Strings are skipped with memchr, which glibc
+// vectorizes. Anything unusual (escaped strings, non-numeric bounds, malformed input) makes
+// the fast path give up, and the file is re-read with jsoncpp instead.
+class JsonCursor {
+public:
+    explicit JsonCursor(string_view text) : p(text.data()), end(text.data() + text.size()) {}
+
+    void skipSpaces() {
+        while (p != end && (*p == ' ' || *p == '\n' || *p == '\t' || *p == '\r')) ++p;
+    }
+
+    bool consume(char c) {
+        skipSpaces();
+        if (p == end || *p != c) return false;
+        ++p;
+        return true;
+    }
+
+    bool peek(char c) {
+        skipSpaces();
+        return p != end && *p == c;
+    }
+
+    bool atEnd() {
+        skipSpaces();
+        return p == end;
+    }
+
+    // A string without escape sequences, returned as a view into the input.
+    bool plainString(string_view &out) {
+        if (!consume('"')) return false;
+        const char *close = static_cast<const char *>(memchr(p, '"', end - p));
+        if (!close || memchr(p, '\\', close - p)) return false;
+        out = string_view(p, close - p);
+        p = close + 1;
+        return true;
+    }
+
+    bool number(double &value) {
+        skipSpaces();
+        auto [next, ec] = from_chars(p, end, value);
+        if (ec != errc()) return false;
+        p = next;
+        return true;
+    }
+
+    // Skip over any JSON value.
+    bool skipValue() {
+        skipSpaces();
+        if (p == end) return false;
+        if (*p == '"') {
+            for (++p;;) {
+                const char *close = static_cast<const char *>(memchr(p, '"', end - p));
+                if (!close) return false;
+                const char *back = close;
+                while (back > p && back[-1] == '\\') --back;
+                p = close + 1;
+                if ((close - back) % 2 == 0) return true; // Not escaped.
+            }
+        }
+        if (*p == '{' || *p == '[') {
+            char close = (*p == '{') ? '}' : ']';
+            ++p;
+            if (consume(close)) return true;
+            do {
+                if (close == '}' && (!skipValue() || !consume(':'))) return false;
+                if (!skipValue()) return false;
+            } while (consume(','));
+            return consume(close);
+        }
+        // Number or literal: runs until a delimiter.
+        const char *start = p;
+        while (p != end && !strchr(",}] \n\t\r", *p)) ++p;
+        return p != start;
+    }
+
+private:
+    const char *p;
+    const char *end;
+};
+
+// "[low, high, ...]" into row[low] and row[low + 1]. Missing entries stay 0, as in jsoncpp.
+bool readRange(JsonCursor &in, array<double, RANGE_COLUMNS> &row, RangeColumn low) {
+    row[low] = row[low + 1] = 0.0;
+    if (!in.consume('[')) return false;
+    if (in.consume(']')) return true;
+    int i = 0;
+    do {
+        double value;
+        if (!in.number(value)) return false;
+        if (i < 2) row[low + i] = value;
+        ++i;
+    } while (in.consume(','));
+    return in.consume(']');
+}
+
+// Fast path. Returns false whenever the file needs the full jsoncpp parser.
+bool parseCandidateOnDemand(string_view text, const string &labelKey, string_view &label, array<double, RANGE_COLUMNS> &row) {
+    static const pair<string_view, RangeColumn> RANGE_KEYS[] = {
+        { "heart_rate_range", HEART_RATE_LOW }, { "object_temp_range", OBJECT_TEMP_LOW },
+        { "ambient_temp_range", AMBIENT_TEMP_LOW }, { "spo2_range", SPO2_LOW },
+    };
+    row.fill(0.0);
+    label = string_view();
+    JsonCursor in(text);
+    if (!in.consume('{')) return false;
+    if (!in.consume('}')) {
+        do {
+            string_view key;
+            if (!in.plainString(key) || !in.consume(':')) return false;
+            auto range = find_if(begin(RANGE_KEYS), end(RANGE_KEYS), [&](const auto &r) { return r.first == key; });
+            bool ok;
+            if (key == labelKey) {
+                ok = in.plainString(label);
+            } else if (range != end(RANGE_KEYS)) {
+                ok = readRange(in, row, range->second);
+            } else if (key == "motion_values" && in.peek('{')) {
+                in.consume('{');
+                ok = true;
+                if (!in.consume('}')) {
+                    do {
+                        string_view inner;
+                        ok = in.plainString(inner) && in.consume(':')
+                          && (inner == "acceleration_x" ? readRange(in, row, MOTION_LOW) : in.skipValue());
+                    } while (ok && in.consume(','));
+                    ok = ok && in.consume('}');
+                }
+            } else {
+                ok = in.skipValue();
+            }
+            if (!ok) return false;
+        } while (in.consume(','));
+        if (!in.consume('}')) return false;
+    }
+    return in.atEnd();
+}
+
+// Read 'path' into 'buffer', reusing its capacity from one file to the next.
+bool readFileInto(const fs::path &path, string &buffer) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st;
+    bool ok = fstat(fd, &st) == 0;
+    if (ok) {
+        buffer.resize(st.st_size);
+        ok = ::read(fd, buffer.data(), buffer.size()) == (ssize_t)buffer.size();
+    }
+    ::close(fd);
+    return ok;
+}
+
+// Read one candidate file. Returns false if it has no label under 'labelKey' or is not
+// valid JSON; the latter is reported, since it used to abort the whole run.
+bool parseCandidateFile(const fs::path &path, const string &labelKey, string &label, array<double, RANGE_COLUMNS> &row) {
+    thread_local string buffer;
+    if (!readFileInto(path, buffer)) return false;
+    string_view fastLabel;
+    if (parseCandidateOnDemand(buffer, labelKey, fastLabel, row)) {
+        label.assign(fastLabel);
+        return !label.empty();
+    }
+
+    // Fallback: full DOM parse.
+    try {
+        Json::Value candidate;
+        istringstream file(buffer);
+        file >> candidate;
+        label = candidate.get(labelKey, "").asString();
+        if (label.empty()) return false;
+        auto range = [&](const Json::Value &r, RangeColumn low) {
+            row[low] = r[0].asDouble();
+            row[low + 1] = r[1].asDouble();
+        };
+        range(candidate["heart_rate_range"], HEART_RATE_LOW);
+        range(candidate["object_temp_range"], OBJECT_TEMP_LOW);
+        range(candidate["ambient_temp_range"], AMBIENT_TEMP_LOW);
+        range(candidate["spo2_range"], SPO2_LOW);
+        range(candidate["motion_values"]["acceleration_x"], MOTION_LOW);
+        return true;
+    } catch (const exception &e) {
+        cerr << "Warning: skipping candidate " << path << ": " << e.what() << endl;
+        return false;
+    }
+}
+
+// Files handed to one pool job; large enough to amortize the queueing.
+const size_t CANDIDATE_FILES_PER_JOB = 64;
+
+// Parse every .json file of 'dirPath' and lay the results out as an index image.
+// The files are parsed in batches on the shared pool and merged in directory order.
+vector<char> buildCandidateIndexImage(const string &dirPath, const string &labelKey, int64_t dirMtime) {
+    vector<fs::path> paths;
+    error_code ec;
+    for (const auto &entry : fs::directory_iterator(dirPath, ec))
+        if (entry.path().extension() == ".json")
+            paths.push_back(entry.path());
+
+    struct Batch {
+        vector<string> labels;
+        vector<array<double, RANGE_COLUMNS>> rows;
+    };
+    vector<future<Batch>> pending;
+    for (size_t first = 0; first < paths.size(); first += CANDIDATE_FILES_PER_JOB) {
+        size_t last = min(paths.size(), first + CANDIDATE_FILES_PER_JOB);
+        pending.push_back(candidateParsePool().submit([&paths, &labelKey, first, last] {
+            Batch batch;
+            string label;
+            array<double, RANGE_COLUMNS> row;
+            for (size_t i = first; i < last; ++i) {
+                if (parseCandidateFile(paths[i], labelKey, label, row)) {
+                    batch.labels.push_back(move(label));
+                    batch.rows.push_back(row);
+                }
+            }
+            return batch;
+        }));
+    }
+    vector<string> labels;
+    vector<array<double, RANGE_COLUMNS>> rows;
+    for (auto &f : pending) {
+        Batch batch = f.get();
+        move(batch.labels.begin(), batch.labels.end(), back_inserter(labels));
+        rows.insert(rows.end(), batch.rows.begin(), batch.rows.end());
+    }
+
+    CandidateIndexHeader header;
+    memcpy(header.magic, CANDIDATE_INDEX_MAGIC, 4);
+    header.version = CANDIDATE_INDEX_VERSION;
+    header.dirMtime = dirMtime;
+    header.count = rows.size();
+    header.labelBytes = 0;
+    for (const string &label : labels) header.labelBytes += label.size();
+    vector<char> grids;
+    for (int pair = 0; pair < RANGE_PAIRS; ++pair)
+        appendRangeGrid(rows, pair, grids);
+    header.gridBytes = grids.size();
+
+    vector<char> image(candidateIndexSize(header.count, header.labelBytes, header.gridBytes));
+    char *p = image.data();
+    memcpy(p, &header, sizeof(header));
+    p += sizeof(header);
+    for (int c = 0; c < RANGE_COLUMNS; ++c) {
+        for (const auto &row : rows) {
+            memcpy(p, &row[c], sizeof(double));
+            p += sizeof(double);
+        }
+    }
+    uint64_t offset = 0;
+    for (size_t i = 0; i <= labels.size(); ++i) {
+        memcpy(p, &offset, sizeof(offset));
+        p += sizeof(offset);
+        if (i < labels.size()) offset += labels[i].size();
+    }
+    memcpy(p, grids.data(), grids.size());
+    p += grids.size();
+    for (const string &label : labels) {
+        memcpy(p, label.data(), label.size());
+        p += label.size();
+    }
+    return image;
+}
+
+// Load the index of 'dirPath', rebuilding it first if it is missing or out of date.
+CandidateIndex loadCandidateIndex(const string &dirPath, const string &labelKey, const string &cacheDir = INDEX_CACHE_DIR) {
+    int64_t dirMtime = directoryMtime(dirPath);
+    string dirName = fs::path(dirPath).parent_path().filename().string();
+    string indexPath = cacheDir + dirName + "." + labelKey + ".idx";
+
+    MappedFile cached(indexPath);
+    if (dirMtime != -1 && CandidateIndex::isValidImage(cached.text(), dirMtime))
+        return CandidateIndex(move(cached));
+
+    vector<char> image;
+    {
+        ScopedTimer timer("scan: " + dirName);
+        image = buildCandidateIndexImage(dirPath, labelKey, dirMtime);
+    }
+
+    // Publish through a rename so a concurrent run never maps a half-written index.
+    error_code ec;
+    fs::create_directories(cacheDir, ec);
+    if (!replaceFileContents(indexPath, string_view(image.data(), image.size())))
+        return CandidateIndex(move(image)); // Cache not writable: use the in-memory image.
+    MappedFile mapped(indexPath);
+    if (CandidateIndex::isValidImage(mapped.text(), dirMtime))
+        return CandidateIndex(move(mapped));
+    return CandidateIndex(move(image));
+}
+
+// ---------------------------
+// Candidate Selection Functions
+// ---------------------------
+// Compute confidence percentage using sensor thresholds.
+double computeConfidence(double sensorValue, double low, double high) {
+    double mid = (low + high) / 2.0;
+    double rangeHalf = (high - low) / 2.0;
+    double diff = fabs(sensorValue - mid);
+    double conf = 100.0 - (diff / (rangeHalf + 1e-6)) * 50.0;
+    if (conf < 0) conf = 0;
+    if (conf > 100) conf = 100;
+    return conf;
+}
+
+// Streaming top-K selector. The K best (candidate, score) pairs seen so far are kept in a
+// min-heap, so the weakest of them sits at the front and is the one a better offer evicts.
+// Costs O(n log K) time and O(K) memory instead of sorting all n candidates. Equal scores
+// rank by candidate id, lowest first, so the result does not depend on the offer order.
+class TopK {
+public:
+    explicit TopK(size_t k) : k(k) { heap.reserve(k); }
+
+    void offer(size_t id, double score) {
+        if (k == 0) return;
+        if (heap.size() < k) {
+            heap.push_back({ score, id });
+            push_heap(heap.begin(), heap.end(), better);
+        } else if (better({ score, id }, heap.front())) {
+            pop_heap(heap.begin(), heap.end(), better);
+            heap.back() = { score, id };
+            push_heap(heap.begin(), heap.end(), better);
+        }
+    }
+
+    bool full() const { return heap.size() == k; }
+    // Score an offer has to beat once full().
+    double worstScore() const { return heap.empty() ? -INFINITY : heap.front().first; }
+
+    // The kept candidates, best first.
+    vector<pair<double, size_t>> sortedDescending() const {
+        vector<pair<double, size_t>> result = heap;
+        sort_heap(result.begin(), result.end(), better);
+        return result;
+    }
+
+private:
+    static bool better(const pair<double, size_t> &a, const pair<double, size_t> &b) {
+        return a.first > b.first || (a.first == b.first && a.second < b.second);
+    }
+
+    size_t k;
+    vector<pair<double, size_t>> heap;
+};
+
+// Batch scoring: the four range dimensions of candidates [first, first + n) of 'index' are
+// scored against sensor[0..3] (heart rate, object temp, ambient temp, SpO2) in one vector
+// pass, writing each candidate's average confidence to 'out'.
+void scoreCandidates(const CandidateIndex &index, const double sensor[4], size_t first, size_t n, double *out) {
+    const double *low[4] = {
+        index.column(HEART_RATE_LOW) + first, index.column(OBJECT_TEMP_LOW) + first,
+        index.column(AMBIENT_TEMP_LOW) + first, index.column(SPO2_LOW) + first
+    };
+    const double *high[4] = {
+        index.column(HEART_RATE_HIGH) + first, index.column(OBJECT_TEMP_HIGH) + first,
+        index.column(AMBIENT_TEMP_HIGH) + first, index.column(SPO2_HIGH) + first
+    };
+    sensorKernels().averageConfidence4(low, high, sensor, n, out);
+}
+
+// Sensor readings matched against a candidate's four ranges, in scoreCandidates order:
+// heart rate, object temp, ambient temp, SpO2.
+using SensorReading = array<double, 4>;
+
+// Offer every candidate of 'index', scored block by block.
+void offerAllCandidates(const CandidateIndex &index, const SensorReading &sensor, TopK &best) {
+    double scores[SAMPLE_BLOCK_SIZE];
+    for (size_t first = 0; first < index.size(); first += SAMPLE_BLOCK_SIZE) {
+        size_t n = min(SAMPLE_BLOCK_SIZE, index.size() - first);
+        scoreCandidates(index, sensor.data(), first, n, scores);
+        for (size_t i = 0; i < n; ++i)
+            best.offer(first + i, scores[i]);
+    }
+}
+
+// Below this many candidates the vectorized full scan is faster than gathering the
+// supported ones (measured with --bench).
+const size_t MIN_CANDIDATES_FOR_GRID = 20000;
+
+// Offer the candidates the range grids place in the support of some reading. The grids only
+// yield ids, so counting how many supports each candidate is in touches one byte per visit,
+// without a branch; the ranges themselves are read only for candidates that get scored. A
+// candidate in c supports averages at most 25 * c, so those in three or four are scored
+// first, then those in two, then those in one, and the rest are skipped once the kept
+// candidates all beat the bound of the next level. Candidates in no support score 0, so of
+// those only the lowest ids can place, to fill up the result.
+void offerSupportedCandidates(const CandidateIndex &index, const SensorReading &sensor, size_t topCount, TopK &best) {
+    static const RangeColumn LOW[4] = { HEART_RATE_LOW, OBJECT_TEMP_LOW, AMBIENT_TEMP_LOW, SPO2_LOW };
+    const uint8_t SCORED = 0x80;
+    auto forEachSupported = [&](auto fn) {
+        for (int d = 0; d < 4; ++d) index.forEachInSupport(LOW[d], sensor[d], fn);
+    };
+    // Scratch reused across calls; all zero between calls.
+    thread_local vector<uint8_t> supports;
+    if (supports.size() < index.size()) supports.resize(index.size());
+    uint8_t *supportCount = supports.data();
+    forEachSupported([&](size_t i) { ++supportCount[i]; });
+
+    double lowBlock[4][SAMPLE_BLOCK_SIZE], highBlock[4][SAMPLE_BLOCK_SIZE], scores[SAMPLE_BLOCK_SIZE];
+    const double *low[4] = { lowBlock[0], lowBlock[1], lowBlock[2], lowBlock[3] };
+    const double *high[4] = { highBlock[0], highBlock[1], highBlock[2], highBlock[3] };
+    uint32_t ids[SAMPLE_BLOCK_SIZE];
+    size_t pending = 0;
+    auto scorePending = [&] {
+        sensorKernels().averageConfidence4(low, high, sensor.data(), pending, scores);
+        for (size_t k = 0; k < pending; ++k)
+            best.offer(ids[k], scores[k]);
+        pending = 0;
+    };
+    for (int c = 3; c >= 1; --c) {
+        // A candidate is in several lists; SCORED makes it count once.
+        forEachSupported([&](size_t i) {
+            if (supportCount[i] < c || (supportCount[i] & SCORED)) return;
+            supportCount[i] |= SCORED;
+            for (int d = 0; d < 4; ++d) {
+                lowBlock[d][pending] = index.column(LOW[d])[i];
+                highBlock[d][pending] = index.column(RangeColumn(LOW[d] + 1))[i];
+            }
+            ids[pending] = uint32_t(i);
+            if (++pending == SAMPLE_BLOCK_SIZE) scorePending();
+        });
+        if (pending > 0) scorePending();
+        if (best.full() && best.worstScore() > 25.0 * (c - 1)) break;
+    }
+
+    for (size_t i = 0, offered = 0; i < index.size() && offered < topCount; ++i) {
+        if (supportCount[i]) continue;
+        best.offer(i, 0.0);
+        ++offered;
+    }
+    fill(supportCount, supportCount + index.size(), 0); // One byte per candidate, unlike a rescan.
+}
+
+// For core words and emotions: match each reading against its own range and keep the
+// best 'topCount' by average confidence. Only candidates in range of some reading are
+// scored; a reading that is not finite scores every candidate. Labels are copied out for
+// the winners only.
+vector<pair<string, double>> selectTopCandidates(const CandidateIndex &index, const SensorReading &sensor, int topCount) {
+    TopK best(max(topCount, 0));
+    if (index.size() >= MIN_CANDIDATES_FOR_GRID
+        && all_of(sensor.begin(), sensor.end(), [](double v) { return isfinite(v); }))
+        offerSupportedCandidates(index, sensor, max(topCount, 0), best);
+    else
+        offerAllCandidates(index, sensor, best);
+    vector<pair<string, double>> candidates;
+    for (const auto &[conf, i] : best.sortedDescending())
+        candidates.push_back({ string(index.label(i)), conf });
+    return candidates;
+}
+
+// For body language: choose the best candidate, the lowest id on ties. Candidates outside
+// the motion grid cell score 0, so only candidate 0 and those in the cell need checking.
+pair<string, double> selectBestBodyLanguage(const CandidateIndex &index, double sensorValue) {
+    size_t bestId = index.size();
+    double bestConf = -1.0;
+    auto consider = [&](size_t i) {
+        double conf = computeConfidence(sensorValue, index.column(MOTION_LOW)[i], index.column(MOTION_HIGH)[i]);
+        if (conf > bestConf || (conf == bestConf && i < bestId)) {
+            bestConf = conf;
+            bestId = i;
+        }
+    };
+    if (isfinite(sensorValue)) {
+        if (!index.empty()) consider(0);
+        index.forEachInSupport(MOTION_LOW, sensorValue, consider);
+    } else {
+        for (size_t i = 0; i < index.size(); ++i) consider(i);
+    }
+    return { bestId < index.size() ? string(index.label(bestId)) : "", bestConf };
+}
+
+// ---------------------------
+// USB Camera Snapshot
+// ---------------------------
+// The camera is opened once and kept open by a background thread that grabs frames
+// continuously into a double buffer: it fills the back frame, then swaps it to the front
+// under a short lock. A snapshot just encodes the newest front frame, so it pays neither a
+// process spawn (fswebcam) nor a device open, and auto-exposure has long settled.
+const int CAMERA_DEVICE = 0;
+const int CAMERA_WIDTH = 640, CAMERA_HEIGHT = 480;
+const int CAMERA_JPEG_QUALITY = 85;
+// Frames to let pass after opening before the first snapshot; replaces fswebcam's "-D 1".
+const size_t CAMERA_WARMUP_FRAMES = 15;
+const auto CAMERA_FRAME_TIMEOUT = chrono::seconds(3);
+
+class CameraService {
+public:
+    ~CameraService() { stop(); }
+
+    // Open the device and start grabbing. Safe to call again once it is running.
+    bool start() {
+        lock_guard<mutex> lock(controlMutex);
+        if (running) return true;
+        ScopedTimer timer("camera: open");
+        if (!capture.open(CAMERA_DEVICE)) {
+            cerr << "Error: USB camera not detected." << endl;
+            return false;
+        }
+        capture.set(cv::CAP_PROP_FRAME_WIDTH, CAMERA_WIDTH);
+        capture.set(cv::CAP_PROP_FRAME_HEIGHT, CAMERA_HEIGHT);
+        capture.set(cv::CAP_PROP_BUFFERSIZE, 1); // Keep the driver queue short so frames are fresh.
+        running = true;
+        grabber = thread([this] { grabLoop(); });
+        return true;
+    }
+
+    void stop() {
+        lock_guard<mutex> lock(controlMutex);
+        if (!running) return;
+        running = false;
+        grabber.join();
+        capture.release();
+    }
+
+    // Write the newest frame, waiting for the camera to warm up if it was just opened.
+    bool snapshot(const string &imagePath) {
+        if (!start()) return false;
+        cv::Mat frame;
+        {
+            ScopedTimer timer("camera: wait for frame");
+            unique_lock<mutex> lock(frameMutex);
+            frameReady.wait_for(lock, CAMERA_FRAME_TIMEOUT, [this] { return framesGrabbed >= CAMERA_WARMUP_FRAMES || !running; });
+            if (framesGrabbed > 0) frame = frames[front].clone();
+        }
+        if (frame.empty()) {
+            cerr << "Error: Captured empty frame from camera." << endl;
+            return false;
+        }
+        ScopedTimer timer("camera: encode");
+        return cv::imwrite(imagePath, frame, { cv::IMWRITE_JPEG_QUALITY, CAMERA_JPEG_QUALITY });
+    }
+
+private:
+    void grabLoop() {
+        while (running) {
+            cv::Mat &back = frames[1 - front]; // Only this thread ever touches the back frame.
+            if (!capture.read(back) || back.empty()) {
+                this_thread::sleep_for(chrono::milliseconds(50));
+                continue;
+            }
+            {
+                lock_guard<mutex> lock(frameMutex);
+                front = 1 - front;
+                ++framesGrabbed;
+            }
+            frameReady.notify_all();
+        }
+    }
+
+    mutex controlMutex; // Serializes start() and stop().
+    cv::VideoCapture capture;
+    thread grabber;
+    atomic<bool> running { false };
+
+    mutex frameMutex;
+    condition_variable frameReady;
+    cv::Mat frames[2];
+    int front = 0;
+    size_t framesGrabbed = 0;
+};
+
+// One camera per process; it stays open for as long as the process runs.
+CameraService &cameraService() {
+    static CameraService service;
+    return service;
+}
+
+bool captureCameraSnapshot(const string &imagePath) {
+    return cameraService().snapshot(imagePath);
+}
+
+// ---------------------------
+// Document Generation
+// ---------------------------
+// Create a DOCX file from content via pandoc.
+void createDocxDirectly(const string &docxPath, const string &content) {
+    string command = "echo \"" + escapeShellArg(content) + "\" | pandoc -f markdown -o " + docxPath
+                     + " --resource-path=" + fs::path(docxPath).parent_path().string();
+    ScopedTimer timer("tool: pandoc");
+    system(command.c_str());
+}
+
+// ---------------------------
+// Convert DOCX to JPG
+// ---------------------------
+// A cold "libreoffice --headless" start costs several seconds per profile. In daemon mode one
+// headless office instance is left running with a UNO socket listener, and each conversion
+// is sent to it by unoconv instead. The instance is detached, so later runs reuse it too.
+const int CONVERTER_PORT = 2002;
+const string CONVERTER_ACCEPT = "socket,host=127.0.0.1,port=" + to_string(CONVERTER_PORT) + ";urp;";
+const int CONVERTER_STARTUP_TIMEOUT_MS = 30000;
+
+// Owner of the socket listening on CONVERTER_PORT, from /proc/net/tcp and tcp6, or -1 if
+// nothing listens there.
+long converterListenerUid() {
+    char port[8];
+    snprintf(port, sizeof port, ":%04X", CONVERTER_PORT);
+    for (const char *table : { "/proc/net/tcp", "/proc/net/tcp6" }) {
+        ifstream in(table);
+        string line;
+        getline(in, line); // Column headings.
+        while (getline(in, line)) {
+            // sl local_address rem_address st tx_queue:rx_queue tr:tm->when retrnsmt uid ...
+            istringstream fields(line);
+            string slot, local, remote, state, queues, timer, retransmits;
+            long uid;
+            if (!(fields >> slot >> local >> remote >> state >> queues >> timer >> retransmits >> uid)) continue;
+            if (state == "0A" && local.size() > 5 && local.compare(local.size() - 5, 5, port) == 0) return uid;
+        }
+    }
+    return -1;
+}
+
+// True if our own converter accepts connections on the converter port. A listener owned
+// by another user is never used, since it would receive every converted document.
+bool isConverterListening() {
+    if (converterListenerUid() != long(getuid())) return false;
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) return false;
+    sockaddr_in addr {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(CONVERTER_PORT);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    bool listening = connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) == 0;
+    close(fd);
+    return listening;
+}
+
+// Full path of executable 'name' found on PATH, or "" if there is none.
+string findExecutable(const string &name) {
+    const char *path = getenv("PATH");
+    istringstream dirs(path ? path : "/usr/bin:/bin");
+    string dir;
+    while (getline(dirs, dir, ':')) {
+        string candidate = (dir.empty() ? "." : dir) + "/" + name;
+        if (access(candidate.c_str(), X_OK) == 0) return candidate;
+    }
+    return "";
+}
+
+// Start the headless converter if it isn't running yet, and wait until it accepts jobs.
+bool ensureConverterDaemon() {
+    long owner = converterListenerUid();
+    if (owner != -1 && owner != long(getuid())) {
+        cerr << "Warning: port " << CONVERTER_PORT << " belongs to another user; not using the converter daemon." << endl;
+        return false;
+    }
+    if (isConverterListening()) return true;
+
+    // Everything the children need is prepared here: other threads may hold the malloc
+    // lock at fork(), so the children only make async-signal-safe calls.
+    string soffice = findExecutable("soffice");
+    if (soffice.empty()) {
+        cerr << "Error: could not start soffice: not found on PATH" << endl;
+        return false;
+    }
+    string accept = "--accept=" + CONVERTER_ACCEPT;
+    const char *argv[] = { "soffice", "--headless", "--invisible", "--nologo", "--norestore",
+                           "--nodefault", accept.c_str(), nullptr };
+    long maxFd = sysconf(_SC_OPEN_MAX);
+    if (maxFd < 0) maxFd = 1024;
+
+    // The close-on-exec pipe reports an exec failure right away: it reads EOF if exec
+    // succeeded and an errno value if it did not.
+    int status[2];
+    if (pipe2(status, O_CLOEXEC) != 0) return false;
+    pid_t child = fork();
+    if (child < 0) {
+        close(status[0]);
+        close(status[1]);
+        return false;
+    }
+    if (child == 0) {
+        // Double fork: the office process is re-parented to init and outlives this run.
+        setsid();
+        if (fork() == 0) {
+            // Descriptors other threads opened without close-on-exec (the camera device,
+            // staging files being written) must not live on in the office process.
+            bool closed = false;
+#ifdef CLOSE_RANGE_CLOEXEC
+            closed = close_range(3, ~0U, CLOSE_RANGE_CLOEXEC) == 0;
+#endif
+            for (long fd = 3; !closed && fd < maxFd; ++fd)
+                if (fd != status[1]) close(int(fd));
+            execv(soffice.c_str(), const_cast<char *const *>(argv));
+            int err = errno;
+            (void)!write(status[1], &err, sizeof(err));
+        }
+        _exit(0);
+    }
+    close(status[1]);
+    waitpid(child, nullptr, 0);
+    int execError = 0;
+    bool failed = read(status[0], &execError, sizeof(execError)) == sizeof(execError);
+    close(status[0]);
+    if (failed) {
+        cerr << "Error: could not start soffice: " << strerror(execError) << endl;
+        return false;
+    }
+    for (int waited = 0; waited < CONVERTER_STARTUP_TIMEOUT_MS; waited += 100) {
+        if (isConverterListening()) return true;
+        this_thread::sleep_for(chrono::milliseconds(100));
+    }
+    cerr << "Error: converter daemon did not start listening on port " << CONVERTER_PORT << "." << endl;
+    return false;
+}
+
+// Convert DOCX to PDF via LibreOffice and then to JPG via ImageMagick.
+// With 'useDaemon' the PDF comes from the persistent converter; if that fails for any
+// reason, a one-off LibreOffice process is used as before.
+void convertDocxToJpg(const string &docxPath, const string &imgPath, bool useDaemon = false) {
+    string pdfPath = fs::path(docxPath).replace_extension(".pdf").string();
+    bool converted = false;
+    if (useDaemon && ensureConverterDaemon()) {
+        string command = "unoconv --connection '" + CONVERTER_ACCEPT + "StarOffice.ComponentContext' -f pdf -o "
+                         + pdfPath + " " + docxPath;
+        ScopedTimer timer("tool: unoconv");
+        converted = system(command.c_str()) == 0 && fs::exists(pdfPath);
+    }
+    if (!converted) {
+        string command = "libreoffice --headless --convert-to pdf " + docxPath + " --outdir "
+                         + fs::path(docxPath).parent_path().string();
+        ScopedTimer timer("tool: libreoffice");
+        system(command.c_str());
+    }
+    string command = "convert -density 150 " + pdfPath + " -quality 90 " + imgPath;
+    ScopedTimer timer("tool: convert pdf");
+    system(command.c_str());
+    if (fs::exists(pdfPath)) fs::remove(pdfPath);
+    // The DOCX is preserved.
+}
+
+// ---------------------------
+// Create Log Screenshot
+// ---------------------------
+// Generate an image from the full contents of LOG_FILE using ImageMagick's caption.
+// 'logText' is the log as the pipeline read it.
+void createLogScreenshot(string logText, const string &imagePath) {
+    replace(logText.begin(), logText.end(), '\n', ' ');
+    string escapedLog = escapeShellArg(logText);
+    string command = "convert -background white -fill black -font Liberation-Sans -pointsize 12 caption:\"" 
+                     + escapedLog + "\" " + imagePath;
+    ScopedTimer timer("tool: convert caption");
+    system(command.c_str());
+}
+
+// ---------------------------
+// Profile Document
+// ---------------------------
+// The state profile as a list of styled blocks. The same document is turned into Markdown
+// for the optional pandoc/DOCX export and drawn directly into the JPG by the native renderer.
+enum class DocStyle { Title, Heading, Bullet, Paragraph, SmallPrint };
+
+struct DocBlock {
+    DocStyle style;
+    string text;
+};
+
+using ProfileDocument = vector<DocBlock>;
+
+// The small-print log is cut to its newest lines: drawn in full, a long LOG_FILE would make
+// an image taller than a JPEG can be (65,535 px) and hundreds of MB in memory.
+const size_t MAX_LOG_LINES_DRAWN = 1000;
+const size_t MAX_LOG_BYTES_DRAWN = 100 * 1024;
+
+// The newest lines of 'text', at most MAX_LOG_LINES_DRAWN of them and MAX_LOG_BYTES_DRAWN
+// bytes, starting at a line boundary where possible. 'omittedLines' is set to the number of
+// lines cut off above them.
+string_view newestLogLines(string_view text, size_t &omittedLines) {
+    size_t start = text.size() > MAX_LOG_BYTES_DRAWN ? text.size() - MAX_LOG_BYTES_DRAWN : 0;
+    if (start > 0 && text[start - 1] != '\n') {
+        size_t next = text.find('\n', start);
+        if (next != string_view::npos && next + 1 < text.size()) start = next + 1;
+    }
+    // Count lines back from the end; a final line without '\n' counts too.
+    size_t lines = 0;
+    for (size_t pos = text.size(); pos > start; --pos) {
+        if (text[pos - 1] == '\n' && pos != text.size() && ++lines == MAX_LOG_LINES_DRAWN) {
+            start = pos;
+            break;
+        }
+    }
+    omittedLines = count(text.begin(), text.begin() + start, '\n');
+    return text.substr(start);
+}
+
+string formatFixed(double value, int precision = 3) {
+    ostringstream out;
+    out << fixed << setprecision(precision) << value;
+    return out.str();
+}
+
+ProfileDocument buildProfileDocument(const vector<pair<string, double>> &topCoreWords,
+                                     const vector<pair<string, double>> &topCoreEmotions,
+                                     const pair<string, double> &bestBodyLanguage,
+                                     double avgBPM, double avgSpO2, double avgAmbient, double avgObject,
+                                     double bestMotion, const string &logText) {
+    ProfileDocument doc;
+    doc.push_back({ DocStyle::Title, "State Profile" });
+    doc.push_back({ DocStyle::Heading, "Core Words:" });
+    for (const auto &cw : topCoreWords)
+        doc.push_back({ DocStyle::Bullet, cw.first + " [" + formatFixed(cw.second) + "%]" });
+    doc.push_back({ DocStyle::Heading, "Core Emotions:" });
+    for (const auto &ce : topCoreEmotions)
+        doc.push_back({ DocStyle::Bullet, ce.first + " [" + formatFixed(ce.second) + "%]" });
+    doc.push_back({ DocStyle::Heading, "Body Language:" });
+    doc.push_back({ DocStyle::Bullet, bestBodyLanguage.first + " [" + formatFixed(bestBodyLanguage.second) + "%]" });
+    doc.push_back({ DocStyle::Heading, "Prompt for Gemini:" });
+    doc.push_back({ DocStyle::Paragraph,
+        "Based on the following, formulate a natural sentence for a fuckin cat to say!!! "
+        "It’s critical that the sentence sounds natural and flows seamlessly—avoid being overly long. "
+        "Incorporate context from the attached images and sensor data." });
+    doc.push_back({ DocStyle::Paragraph,
+        "Avoid robotic or forced phrasing. The sentence should be concise yet reflective of the cat's current state. "
+        "Use the nouns in the image for context." });
+    doc.push_back({ DocStyle::Heading, "Attached:" });
+    doc.push_back({ DocStyle::Bullet, "Screenshot of " + LOG_FILE });
+    doc.push_back({ DocStyle::Heading, "Sensor Summary:" });
+    doc.push_back({ DocStyle::Bullet, "Average Heart Rate: " + formatFixed(avgBPM) + " BPM, Average SpO2: " + formatFixed(avgSpO2) });
+    doc.push_back({ DocStyle::Bullet, "Median Ambient Temp: " + formatFixed(avgAmbient) + " C, Median Object Temp: " + formatFixed(avgObject) + " C" });
+    doc.push_back({ DocStyle::Bullet, "Best Motion (RMS of Gyro): " + formatFixed(bestMotion) });
+    // log.txt in small font at the bottom, its newest lines if it is long.
+    doc.push_back({ DocStyle::Heading, "Log File Contents (small print):" });
+    size_t omitted = 0;
+    string_view shown = newestLogLines(logText, omitted);
+    if (shown.size() == logText.size())
+        doc.push_back({ DocStyle::SmallPrint, logText });
+    else
+        doc.push_back({ DocStyle::SmallPrint, "[" + (omitted > 0 ? to_string(omitted) + " earlier lines" : string("earlier text"))
+                                              + " omitted]\n" + string(shown) });
+    return doc;
+}
+
+// Markdown for pandoc. Every heading follows a blank line; titles and paragraphs already
+// end with one, a list or an empty section gets one here.
+string toMarkdown(const ProfileDocument &doc) {
+    ostringstream md;
+    DocStyle previous = DocStyle::Title;
+    for (const DocBlock &block : doc) {
+        switch (block.style) {
+        case DocStyle::Title:      md << "# " << block.text << "\n\n"; break;
+        case DocStyle::Heading:    md << (previous == DocStyle::Bullet || previous == DocStyle::Heading ? "\n" : "") << "## " << block.text << "\n"; break;
+        case DocStyle::Bullet:     md << "- " << block.text << "\n"; break;
+        case DocStyle::Paragraph:  md << block.text << "\n\n"; break;
+        case DocStyle::SmallPrint: md << "<small>" << block.text << "</small>\n"; break;
+        }
+        previous = block.style;
+    }
+    return md.str();
+}
+
+// ---------------------------
+// Native Rendering
+// ---------------------------
+// Draws the profile straight into a JPEG with OpenCV. This replaces the
+// pandoc -> LibreOffice -> ImageMagick chain, which spent seconds starting processes.
+const int PAGE_WIDTH = 1240;   // A4 width at 150 dpi, like the old PDF conversion.
+const int PAGE_MARGIN = 60;
+const int JPEG_QUALITY = 90;
+// Lines that would reach below this are not laid out, whatever the document holds.
+const int MAX_PAGE_HEIGHT = 65000;
+
+struct TextStyle {
+    int font;
+    double scale;
+    int thickness;
+    int indent;      // Extra left indent in pixels.
+    int spaceBefore; // Vertical gap above the block in pixels.
+};
+
+TextStyle textStyleFor(DocStyle style) {
+    switch (style) {
+    case DocStyle::Title:     return { cv::FONT_HERSHEY_DUPLEX, 1.4, 2, 0, 0 };
+    case DocStyle::Heading:   return { cv::FONT_HERSHEY_DUPLEX, 0.9, 1, 0, 22 };
+    case DocStyle::Bullet:    return { cv::FONT_HERSHEY_SIMPLEX, 0.6, 1, 30, 4 };
+    case DocStyle::Paragraph: return { cv::FONT_HERSHEY_SIMPLEX, 0.6, 1, 0, 8 };
+    default:                  return { cv::FONT_HERSHEY_SIMPLEX, 0.4, 1, 0, 8 };
+    }
+}
+
+// Hershey fonts only cover ASCII, so map the typographic punctuation we use onto it.
+string toRenderableAscii(const string &text) {
+    static const pair<string, string> REPLACEMENTS[] = {
+        { "\u2019", "'" }, { "\u2018", "'" }, { "\u201C", "\"" }, { "\u201D", "\"" },
+        { "\u2014", " - " }, { "\u2013", "-" }, { "\u2022", "*" },
+    };
+    string out = text;
+    for (const auto &[from, to] : REPLACEMENTS) {
+        for (size_t pos = out.find(from); pos != string::npos; pos = out.find(from, pos + to.size()))
+            out.replace(pos, from.size(), to);
+    }
+    for (char &c : out)
+        if (static_cast<unsigned char>(c) >= 0x80 || (c != '\n' && iscntrl(static_cast<unsigned char>(c)))) c = '?';
+    return out;
+}
+
+// Greedy word wrap of one paragraph (no newlines) to 'maxWidth' pixels.
+vector<string> wrapText(const string &text, const TextStyle &style, int maxWidth) {
+    vector<string> lines;
+    string current;
+    istringstream words(text);
+    string word;
+    int baseline = 0;
+    while (words >> word) {
+        string candidate = current.empty() ? word : current + " " + word;
+        if (!current.empty() && cv::getTextSize(candidate, style.font, style.scale, style.thickness, &baseline).width > maxWidth) {
+            lines.push_back(current);
+            current = word;
+        } else {
+            current = candidate;
+        }
+    }
+    if (!current.empty() || lines.empty()) lines.push_back(current);
+    return lines;
+}
+
+struct PlacedLine {
+    string text;
+    TextStyle style;
+    int x, y; // Baseline origin.
+};
+
+// Lay out 'doc' top to bottom; returns the lines and sets 'height' to the page height needed.
+vector<PlacedLine> layoutDocument(const ProfileDocument &doc, int width, int &height) {
+    vector<PlacedLine> placed;
+    int y = PAGE_MARGIN;
+    int baseline = 0;
+    for (const DocBlock &block : doc) {
+        TextStyle style = textStyleFor(block.style);
+        y += style.spaceBefore;
+        int lineHeight = cv::getTextSize("Ag", style.font, style.scale, style.thickness, &baseline).height + baseline + 6;
+        int x = PAGE_MARGIN + style.indent;
+        int maxWidth = width - x - PAGE_MARGIN;
+        string text = toRenderableAscii(block.style == DocStyle::Bullet ? "- " + block.text : block.text);
+        istringstream paragraphs(text);
+        string paragraph;
+        while (getline(paragraphs, paragraph)) {
+            for (const string &line : wrapText(paragraph, style, maxWidth)) {
+                if (y + lineHeight + PAGE_MARGIN > MAX_PAGE_HEIGHT) {
+                    cerr << "Warning: page cut off at " << MAX_PAGE_HEIGHT << " px." << endl;
+                    height = y + PAGE_MARGIN;
+                    return placed;
+                }
+                y += lineHeight;
+                placed.push_back({ line, style, x, y - baseline });
+            }
+        }
+    }
+    height = y + PAGE_MARGIN;
+    return placed;
+}
+
+cv::Mat renderDocument(const ProfileDocument &doc, int width = PAGE_WIDTH) {
+    ScopedTimer timer("render: layout and draw");
+    int height = 0;
+    vector<PlacedLine> lines = layoutDocument(doc, width, height);
+    cv::Mat page(height, width, CV_8UC3, cv::Scalar(255, 255, 255));
+    for (const PlacedLine &line : lines)
+        cv::putText(page, line.text, cv::Point(line.x, line.y), line.style.font, line.style.scale,
+                    cv::Scalar(0, 0, 0), line.style.thickness, cv::LINE_AA);
+    return page;
+}
+
+bool writeJpeg(const string &imgPath, const cv::Mat &image) {
+    ScopedTimer timer("render: encode jpeg");
+    try {
+        if (cv::imwrite(imgPath, image, { cv::IMWRITE_JPEG_QUALITY, JPEG_QUALITY })) return true;
+        cerr << "Error: Could not write " << imgPath << "." << endl;
+    } catch (const exception &e) { // cv::Exception, for one.
+        cerr << "Error: Could not write " << imgPath << ": " << e.what() << endl;
+    }
+    return false;
+}
+
+// Native counterpart of createLogScreenshot(): the newest lines of the log in small print on
+// their own image.
+bool renderLogScreenshot(const string &logText, const string &imgPath) {
+    size_t omitted = 0;
+    string shown(newestLogLines(logText, omitted));
+    ProfileDocument logDoc = { { DocStyle::SmallPrint, shown.empty() ? "No log data available." : shown } };
+    return writeJpeg(imgPath, renderDocument(logDoc));
+}
+
+// ---------------------------
+// Log Screenshot Cache
+// ---------------------------
+// LOG_FILE changes far less often than the profile is regenerated, so finished screenshots
+// are cached in RENDER_CACHE_DIR under an FNV-1a hash of the log text: an unchanged log costs
+// one hash and a hard link. The native renderer additionally keeps the lines it has drawn so
+// far (lossless, without page margins), named by the length and hash of the text they cover, and a
+// log that only grew is drawn by rendering just the new lines under them. That works because
+// every source line is wrapped and drawn on its own, so the drawing of a text ending in '\n'
+// is the top of the drawing of any text that continues it. ImageMagick's caption: flows the
+// whole log as one paragraph, so the legacy screenshot only has the whole-image cache.
+// Every cache file name carries a hash of the log's path, so several logs can share the cache.
+const uint64_t FNV_OFFSET_BASIS = 14695981039346656037ull;
+
+// 64-bit FNV-1a. Passing the hash of a prefix as 'hash' continues it over 'data'.
+uint64_t fnv1a(string_view data, uint64_t hash = FNV_OFFSET_BASIS) {
+    for (unsigned char c : data) {
+        hash ^= c;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+string hexHash(uint64_t hash) {
+    char text[17];
+    snprintf(text, sizeof text, "%016llx", static_cast<unsigned long long>(hash));
+    return text;
+}
+
+// Make 'target' the same file as 'source': a hard link when possible, else a copy.
+bool linkOrCopy(const string &source, const string &target) {
+    error_code ec;
+    fs::remove(target, ec);
+    fs::create_hard_link(source, target, ec);
+    if (ec) fs::copy_file(source, target, fs::copy_options::overwrite_existing, ec);
+    return !ec;
+}
+
+// Put 'source' into the cache as 'cachePath' through a rename, so a concurrent run never
+// links a half-written file.
+void storeInRenderCache(const string &source, const string &cachePath) {
+    string tmpPath = cachePath + tempSuffix();
+    error_code ec;
+    if (linkOrCopy(source, tmpPath)) fs::rename(tmpPath, cachePath, ec);
+    if (ec) fs::remove(tmpPath, ec);
+}
+
+// Remove the cached screenshots named "<prefix>*.jpg" other than 'keep'.
+void pruneRenderCache(const string &prefix, const string &keep) {
+    error_code ec;
+    for (const auto &entry : fs::directory_iterator(RENDER_CACHE_DIR, ec)) {
+        string name = entry.path().filename().string();
+        if (name.rfind(prefix, 0) == 0 && entry.path().extension() == ".jpg" && entry.path() != fs::path(keep))
+            fs::remove(entry.path(), ec);
+    }
+}
+
+// The small-print lines of 'text', drawn exactly as in renderLogScreenshot() but without the
+// page margins above and below them.
+cv::Mat renderLogLines(const string &text) {
+    if (text.empty()) return cv::Mat();
+    cv::Mat page = renderDocument({ { DocStyle::SmallPrint, text } });
+    int top = PAGE_MARGIN + textStyleFor(DocStyle::SmallPrint).spaceBefore;
+    return page.rowRange(top, page.rows - PAGE_MARGIN).clone();
+}
+
+// The kept lines of a log are "log_lines_<key>_<length>_<hash>.png": the image and the text it
+// covers are published together by one rename, so a reader never pairs one with the other's
+// predecessor.
+string keptLinesName(const string &key, size_t length, uint64_t hash) {
+    return "log_lines_" + key + "_" + to_string(length) + "_" + hexHash(hash) + ".png";
+}
+
+// Parse the length and hash out of a kept-lines file name of 'key'.
+bool parseKeptLinesName(const string &name, const string &key, size_t &length, uint64_t &hash) {
+    string prefix = "log_lines_" + key + "_";
+    if (name.rfind(prefix, 0) != 0 || name.size() < prefix.size() + 4 || name.compare(name.size() - 4, 4, ".png") != 0)
+        return false;
+    const char *begin = name.data() + prefix.size(), *end = name.data() + name.size() - 4;
+    auto lengthResult = from_chars(begin, end, length);
+    if (lengthResult.ec != errc() || lengthResult.ptr == end || *lengthResult.ptr != '_') return false;
+    auto hashResult = from_chars(lengthResult.ptr + 1, end, hash, 16);
+    return hashResult.ec == errc() && hashResult.ptr == end && end - (lengthResult.ptr + 1) == 16;
+}
+
+// Rows of kept log lines; older rows are cropped off the top.
+const int MAX_LOG_IMAGE_HEIGHT = 40000;
+
+// Native log screenshot, drawing only the lines that are not in the kept image yet.
+void renderLogScreenshotIncremental(const string &logText, const string &imgPath, const string &key) {
+    // Reuse the longest kept lines whose text the log still starts with.
+    size_t keptLength = 0;
+    uint64_t keptHash = FNV_OFFSET_BASIS;
+    cv::Mat kept;
+    vector<tuple<size_t, uint64_t, fs::path>> candidates;
+    error_code ec;
+    for (const auto &entry : fs::directory_iterator(RENDER_CACHE_DIR, ec)) {
+        size_t length;
+        uint64_t hash;
+        if (parseKeptLinesName(entry.path().filename().string(), key, length, hash) && length <= logText.size()
+            && fnv1a(string_view(logText).substr(0, length)) == hash)
+            candidates.emplace_back(length, hash, entry.path());
+    }
+    sort(candidates.begin(), candidates.end(), greater<>());
+    for (const auto &candidate : candidates) {
+        kept = cv::imread(get<2>(candidate).string(), cv::IMREAD_COLOR);
+        if (kept.empty()) continue; // Pruned by a concurrent run since the listing.
+        keptLength = get<0>(candidate);
+        keptHash = get<1>(candidate);
+        break;
+    }
+
+    // Complete lines are drawn once and kept; a last line still being written is drawn but not kept.
+    // Only the newest lines are drawn, and the kept image is cropped to the newest
+    // MAX_LOG_IMAGE_HEIGHT rows, so neither grows with the log.
+    size_t lastNewline = logText.rfind('\n');
+    size_t complete = (lastNewline == string::npos || lastNewline < keptLength) ? keptLength : lastNewline + 1;
+    size_t omitted = 0;
+    string_view newLines = newestLogLines(string_view(logText).substr(keptLength, complete - keptLength), omitted);
+    if (omitted > 0) kept = cv::Mat(); // Older than anything that will be shown.
+    cv::Mat added = renderLogLines(string(newLines));
+    if (!added.empty()) {
+        if (kept.empty())
+            kept = added;
+        else
+            cv::vconcat(kept, added, kept);
+        if (kept.rows > MAX_LOG_IMAGE_HEIGHT) kept = kept.rowRange(kept.rows - MAX_LOG_IMAGE_HEIGHT, kept.rows).clone();
+        uint64_t completeHash = fnv1a(string_view(logText).substr(keptLength, complete - keptLength), keptHash);
+        string keptName = keptLinesName(key, complete, completeHash);
+        string tmpImage = RENDER_CACHE_DIR + "log_lines_" + key + tempSuffix() + ".png";
+        bool written = cv::imwrite(tmpImage, kept);
+        if (written) fs::rename(tmpImage, RENDER_CACHE_DIR + keptName, ec);
+        if (!written || ec) {
+            fs::remove(tmpImage, ec);
+        } else {
+            // Superseded kept lines, including those of the former "log_lines_<key>.png/.txt" pair.
+            for (const auto &entry : fs::directory_iterator(RENDER_CACHE_DIR, ec)) {
+                string name = entry.path().filename().string();
+                size_t length;
+                uint64_t hash;
+                if (name != keptName && (parseKeptLinesName(name, key, length, hash)
+                                         || name == "log_lines_" + key + ".png" || name == "log_lines_" + key + ".txt"))
+                    fs::remove(entry.path(), ec);
+            }
+        }
+    }
+
+    int top = PAGE_MARGIN + textStyleFor(DocStyle::SmallPrint).spaceBefore;
+    vector<cv::Mat> parts = { cv::Mat(top, PAGE_WIDTH, CV_8UC3, cv::Scalar(255, 255, 255)) };
+    if (!kept.empty()) parts.push_back(kept);
+    cv::Mat unfinished = renderLogLines(string(newestLogLines(string_view(logText).substr(complete), omitted)));
+    if (!unfinished.empty()) parts.push_back(unfinished);
+    parts.push_back(cv::Mat(PAGE_MARGIN, PAGE_WIDTH, CV_8UC3, cv::Scalar(255, 255, 255)));
+    cv::Mat page;
+    cv::vconcat(parts, page);
+    writeJpeg(imgPath, page);
+}
+
+// Write the screenshot of 'logText', read from 'logPath', to 'imgPath' with the native
+// renderer, or with ImageMagick if 'legacy', reusing the cached image when the log has not changed.
+void writeLogScreenshot(const string &logPath, const string &logText, const string &imgPath, bool legacy) {
+    ScopedTimer timer("render: log screenshot");
+    string key = hexHash(fnv1a(logPath));
+    string prefix = (legacy ? "log_legacy_" : "log_native_") + key + "_";
+    string cached = RENDER_CACHE_DIR + prefix + hexHash(fnv1a(logText)) + ".jpg";
+    if (fileExists(cached) && linkOrCopy(cached, imgPath)) return;
+
+    error_code ec;
+    fs::create_directories(RENDER_CACHE_DIR, ec);
+    if (legacy)
+        createLogScreenshot(logText, imgPath);
+    else
+        renderLogScreenshotIncremental(logText, imgPath, key);
+    if (fileExists(imgPath)) {
+        storeInRenderCache(imgPath, cached);
+        pruneRenderCache(prefix, cached);
+    }
+}
+
+// ---------------------------
+// Task Graph
+// ---------------------------
+// A small dependency-aware executor for the pipeline stages. Every task starts as soon as
+// all of its dependencies have finished, so independent stages (camera, log screenshot,
+// sensor processing, ...) overlap. Start and duration are recorded for each task.
+class TaskGraph {
+public:
+    using TaskId = size_t;
+
+    // Dependencies must have been added before the task that needs them.
+    TaskId add(const string &name, const vector<TaskId> &dependencies, function<void()> work) {
+        tasks.push_back({ name, dependencies, move(work), 0.0, 0.0 });
+        return tasks.size() - 1;
+    }
+
+    // Run every task and wait for all of them. The first exception thrown by a task is
+    // rethrown here once the rest of the graph has settled.
+    void run() {
+        auto graphStart = chrono::steady_clock::now();
+        vector<shared_future<void>> done;
+        for (Task &task : tasks) {
+            vector<shared_future<void>> waitFor;
+            for (TaskId dep : task.dependencies) waitFor.push_back(done[dep]);
+            done.push_back(async(launch::async, [&task, waitFor, graphStart] {
+                for (const auto &dep : waitFor) dep.get(); // Propagates a dependency's failure.
+                auto begin = chrono::steady_clock::now();
+                task.startMs = chrono::duration<double, milli>(begin - graphStart).count();
+                task.work();
+                task.durationMs = chrono::duration<double, milli>(chrono::steady_clock::now() - begin).count();
+                if (timingRecorder().isEnabled()) timingRecorder().record("stage: " + task.name, task.durationMs);
+            }).share());
+        }
+        exception_ptr firstError;
+        for (auto &f : done) {
+            try {
+                f.get();
+            } catch (...) {
+                if (!firstError) firstError = current_exception();
+            }
+        }
+        if (firstError) rethrow_exception(firstError);
+    }
+
+    void printTimings(ostream &out) const {
+        ios savedFormat(nullptr);
+        savedFormat.copyfmt(out);
+        out << "Stage timings:\n";
+        for (const Task &task : tasks)
+            out << "  " << left << setw(28) << task.name << right << fixed << setprecision(1)
+                << " start +" << setw(8) << task.startMs << " ms, took " << setw(8) << task.durationMs << " ms\n";
+        out.copyfmt(savedFormat);
+    }
+
+private:
+    struct Task {
+        string name;
+        vector<TaskId> dependencies;
+        function<void()> work;
+        double startMs, durationMs;
+    };
+    vector<Task> tasks;
+};
+
+// ---------------------------
+// Output Publishing
+// ---------------------------
+// A run writes its files into a staging directory of its own and only then renames them into
+// OUTPUT_DIR, the final JPG last. rename() replaces a file atomically, so a reader of OUTPUT_DIR
+// sees either the previous profile or the new one, never a half-written file.
+// Each output set ("profile" for the single profile, "subject-<n>" for a batch subject) has a
+// manifest in PUBLISHED_DIR of the files it last published. Whatever that set published
+// before and this run did not replace (say, the DOCX of an earlier --docx run) is
+// garbage-collected afterwards on a background thread, along with the emptied staging
+// directory. Files of other output sets, or of other programs, are never touched.
+
+// Create an empty staging directory for this run, "<STAGING_DIR><pid>-<run>/".
+string createStagingDir() {
+    static atomic<int> runCounter{0};
+    string dir = STAGING_DIR + to_string(getpid()) + "-" + to_string(runCounter++) + "/";
+    error_code ec;
+    fs::remove_all(dir, ec);
+    fs::create_directories(dir, ec);
+    if (ec) cerr << "Error: Could not create staging directory " << dir << ": " << ec.message() << endl;
+    return dir;
+}
+
+// Atomically replace 'target' with 'source'. A staging directory on another filesystem
+// costs a copy next to the target first.
+bool publishFile(const fs::path &source, const fs::path &target) {
+    error_code ec;
+    fs::rename(source, target, ec);
+    if (ec == errc::cross_device_link) {
+        fs::path tmp = target;
+        tmp += tempSuffix();
+        if (fs::copy_file(source, tmp, fs::copy_options::overwrite_existing, ec)) fs::rename(tmp, target, ec);
+        if (ec) {
+            error_code ignored;
+            fs::remove(tmp, ignored);
+        }
+    }
+    if (ec) cerr << "Error: Could not publish " << target << ": " << ec.message() << endl;
+    return !ec;
+}
+
+// Move every file of 'stagingDir' into OUTPUT_DIR, 'lastName' after all the others, and
+// return the names that were published.
+set<string> publishStagedOutputs(const string &stagingDir, const string &lastName) {
+    error_code ec;
+    fs::create_directories(OUTPUT_DIR, ec);
+    set<string> published;
+    bool haveLast = false;
+    for (const auto &entry : fs::directory_iterator(stagingDir, ec)) {
+        string name = entry.path().filename().string();
+        if (name == lastName)
+            haveLast = true;
+        else if (publishFile(entry.path(), OUTPUT_DIR + name))
+            published.insert(name);
+    }
+    if (haveLast && publishFile(stagingDir + lastName, OUTPUT_DIR + lastName))
+        published.insert(lastName);
+    return published;
+}
+
+// The files one run published, the output set they belong to, and the staging directory it used.
+struct PublishedProfile {
+    string stagingDir;
+    string outputSet;
+    set<string> files;
+};
+
+string publishedManifestPath(const string &outputSet) {
+    return PUBLISHED_DIR + outputSet + ".list";
+}
+
+// File names listed in a manifest, one per line. Anything that is not a plain name in
+// OUTPUT_DIR is ignored.
+set<string> readPublishedManifest(const string &path) {
+    set<string> files;
+    ifstream in(path);
+    string name;
+    while (getline(in, name))
+        if (!name.empty() && name != "." && name != ".." && name.find('/') == string::npos) files.insert(name);
+    return files;
+}
+
+void writePublishedManifest(const string &path, const set<string> &files) {
+    error_code ec;
+    fs::create_directories(PUBLISHED_DIR, ec);
+    string list;
+    for (const string &name : files) list += name + "\n";
+    replaceFileContents(path, list);
+}
+
+// The pid a staging directory "<pid>-<run>" belongs to, or 0 if it isn't one.
+pid_t stagingDirOwner(const string &name) {
+    pid_t pid = 0;
+    auto [next, ec] = from_chars(name.data(), name.data() + name.size(), pid);
+    return (ec == errc() && next != name.data() + name.size() && *next == '-' && pid > 0) ? pid : 0;
+}
+
+// The garbage collection still running, if any. A run waits for it before publishing, so a
+// collection never sees a half-updated OUTPUT_DIR. Batch subjects publish concurrently, so
+// the pending collection is guarded.
+mutex outputCollectionMutex;
+future<void> pendingOutputCollection;
+
+void waitForOutputCollection() {
+    lock_guard<mutex> lock(outputCollectionMutex);
+    if (pendingOutputCollection.valid()) pendingOutputCollection.get();
+}
+
+// In the background, delete the files each of 'runs' published last time and not this time,
+// record what they published now, and remove their staging directories as well as those left
+// behind by processes that no longer exist. A run that published nothing keeps its old files.
+void collectOldOutputs(vector<PublishedProfile> runs) {
+    lock_guard<mutex> lock(outputCollectionMutex);
+    if (pendingOutputCollection.valid()) pendingOutputCollection.get();
+    pendingOutputCollection = async(launch::async, [runs = move(runs)] {
+        set<string> current;
+        for (const PublishedProfile &run : runs) current.insert(run.files.begin(), run.files.end());
+        error_code ec;
+        for (const PublishedProfile &run : runs) {
+            if (run.files.empty()) continue;
+            string manifest = publishedManifestPath(run.outputSet);
+            for (const string &name : readPublishedManifest(manifest))
+                if (!current.count(name)) fs::remove(OUTPUT_DIR + name, ec);
+            writePublishedManifest(manifest, run.files);
+        }
+        for (const PublishedProfile &run : runs) fs::remove_all(run.stagingDir, ec);
+        for (const auto &entry : fs::directory_iterator(STAGING_DIR, ec)) {
+            pid_t owner = stagingDirOwner(entry.path().filename().string());
+            if (owner > 0 && owner != getpid() && kill(owner, 0) != 0 && errno == ESRCH)
+                fs::remove_all(entry.path(), ec);
+        }
+    });
+}
+
+// ---------------------------
+// Benchmark Mode
+// ---------------------------
+// --bench[=MAX_LINES] measures the sensor and selection paths on synthetic data written to a
+// scratch directory under the system temp dir. It runs at every power of ten from 1K lines up
+// to MAX_LINES (1M by default, at most 100M) and reports throughput and the peak resident
+// memory reached inside each function. Candidate directories get one file per log line, up to
+// BENCH_MAX_CANDIDATES.
+const size_t BENCH_MIN_LINES = 1000;
+const size_t BENCH_DEFAULT_LINES = 1000000;
+const size_t BENCH_MAX_LINES = 100000000;
+const size_t BENCH_MAX_CANDIDATES = 100000;
+const size_t BENCH_QUERIES = 100;
+
+// Keeps the optimizer from dropping a benchmarked call whose result is otherwise unused.
+volatile double benchSink;
+
+// Append 'value' with 'precision' decimals, the way the sensor scripts print it.
+void appendFixed(string &buffer, double value, int precision = 2) {
+    char text[32];
+    auto result = to_chars(text, text + sizeof text, value, chars_format::fixed, precision);
+    buffer.append(text, result.ptr);
+}
+
+// Write 'lines' lines to 'path'; makeLine(rng, buffer) appends one line to 'buffer'.
+template<typename MakeLine>
+void writeSyntheticLog(const string &path, size_t lines, MakeLine makeLine) {
+    mt19937_64 rng(lines);
+    string buffer;
+    ofstream out(path, ios::binary);
+    for (size_t i = 0; i < lines; ++i) {
+        makeLine(rng, buffer);
+        if (buffer.size() >= (1 << 20)) {
+            out.write(buffer.data(), buffer.size());
+            buffer.clear();
+        }
+    }
+    out.write(buffer.data(), buffer.size());
+}
+
+void writeSyntheticLogs(const string &heartRatePath, const string &tempPath, const string &motionPath, size_t lines) {
+    writeSyntheticLog(heartRatePath, lines, [](mt19937_64 &rng, string &out) {
+        normal_distribution<double> bpm(75.0, 8.0), spo2(97.0, 1.0);
+        out += "BPM: ";
+        appendFixed(out, rng() % 100 == 0 ? 220.0 : bpm(rng)); // 1% artifacts for the outlier filter.
+        out += ", SpO2: ";
+        appendFixed(out, spo2(rng));
+        out += '\n';
+    });
+    writeSyntheticLog(tempPath, lines, [](mt19937_64 &rng, string &out) {
+        normal_distribution<double> ambient(23.0, 2.0), objectT(36.8, 0.4);
+        out += "Ambient Temp: ";
+        appendFixed(out, ambient(rng));
+        out += " C, Object Temp: ";
+        appendFixed(out, objectT(rng));
+        out += " C\n";
+    });
+    writeSyntheticLog(motionPath, lines, [](mt19937_64 &rng, string &out) {
+        uniform_real_distribution<double> axis(-2.0, 2.0);
+        static const char *const names[6] = { "accel_x: ", ", accel_y: ", ", accel_z: ", ", gyro_x: ", ", gyro_y: ", ", gyro_z: " };
+        for (const char *name : names) {
+            out += name;
+            appendFixed(out, axis(rng), 3);
+        }
+        out += '\n';
+    });
+}
+
+// Fill 'dirPath' with 'count' candidate files labelled under 'labelKey'.
+void writeSyntheticCandidates(const string &dirPath, const string &labelKey, size_t count) {
+    error_code ec;
+    fs::remove_all(dirPath, ec);
+    fs::create_directories(dirPath);
+    mt19937_64 rng(count);
+    uniform_real_distribution<double> heart(40.0, 200.0), objectT(34.0, 41.0), ambient(0.0, 40.0), spo2(85.0, 100.0), motion(0.0, 2.0);
+    auto range = [](double mid, double halfWidth) {
+        return "[" + formatFixed(mid - halfWidth) + ", " + formatFixed(mid + halfWidth) + "]";
+    };
+    for (size_t i = 0; i < count; ++i) {
+        ofstream out(dirPath + labelKey + to_string(i) + ".json");
+        out << "{\"" << labelKey << "\": \"" << labelKey << ' ' << i << "\", "
+            << "\"heart_rate_range\": " << range(heart(rng), 3.0) << ", "
+            << "\"object_temp_range\": " << range(objectT(rng), 0.2) << ", "
+            << "\"ambient_temp_range\": " << range(ambient(rng), 1.0) << ", "
+            << "\"spo2_range\": " << range(spo2(rng), 0.5) << ", "
+            << "\"motion_values\": {\"acceleration_x\": " << range(motion(rng), 0.05) << "}}\n";
+    }
+}
+
+// Candidates whose ranges the grids cannot place in a cell: inverted, zero-width and too
+// wide to bound. --bench checks that selection still agrees with the full scan with them.
+void writeEdgeCaseCandidates(const string &dirPath, const string &labelKey) {
+    const char *ranges[] = {
+        "\"heart_rate_range\": [90, 80], \"spo2_range\": [99, 93]",
+        "\"heart_rate_range\": [75, 75], \"object_temp_range\": [37, 37]",
+        "\"heart_rate_range\": [-1e308, 1e308], \"ambient_temp_range\": [0, 1e300]",
+    };
+    for (size_t i = 0; i < size(ranges); ++i)
+        ofstream(dirPath + labelKey + "_edge" + to_string(i) + ".json")
+            << "{\"" << labelKey << "\": \"" << labelKey << " edge " << i << "\", " << ranges[i] << "}\n";
+}
+
+// Check that selectTopCandidates() picks exactly what a full scan picks for every reading.
+bool selectionMatchesFullScan(const CandidateIndex &index, const vector<SensorReading> &readings) {
+    // The grid path is checked directly as well, since selectTopCandidates only takes it
+    // above MIN_CANDIDATES_FOR_GRID and the bench also runs smaller indexes.
+    auto agree = [&](const vector<pair<double, size_t>> &a, const vector<pair<double, size_t>> &b) {
+        bool same = a.size() == b.size();
+        for (size_t k = 0; same && k < a.size(); ++k)
+            same = a[k].second == b[k].second && (a[k].first == b[k].first || (isnan(a[k].first) && isnan(b[k].first)));
+        return same;
+    };
+    for (const SensorReading &r : readings) {
+        for (int topCount : { 1, 10 }) {
+            TopK best(topCount);
+            offerAllCandidates(index, r, best);
+            vector<pair<double, size_t>> scanned = best.sortedDescending();
+            vector<pair<string, double>> selected = selectTopCandidates(index, r, topCount);
+            bool same = selected.size() == scanned.size();
+            for (size_t k = 0; same && k < selected.size(); ++k) {
+                double a = selected[k].second, b = scanned[k].first;
+                same = selected[k].first == index.label(scanned[k].second) && (a == b || (isnan(a) && isnan(b)));
+            }
+            if (same && all_of(r.begin(), r.end(), [](double v) { return isfinite(v); })) {
+                TopK gridBest(topCount);
+                offerSupportedCandidates(index, r, topCount, gridBest);
+                same = agree(gridBest.sortedDescending(), scanned);
+            }
+            if (!same) {
+                cerr << "Error: selectTopCandidates disagrees with the full scan for reading "
+                     << r[0] << ' ' << r[1] << ' ' << r[2] << ' ' << r[3] << ", top " << topCount << endl;
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// Peak resident set size in KiB since the last resetPeakRss(). Linux resets VmHWM through
+// clear_refs; where that fails the figure is the peak of the whole process so far.
+void resetPeakRss() {
+    ofstream("/proc/self/clear_refs") << "5";
+}
+
+long peakRssKiB() {
+    ifstream status("/proc/self/status");
+    string line;
+    while (getline(status, line))
+        if (line.rfind("VmHWM:", 0) == 0) return atol(line.c_str() + strlen("VmHWM:"));
+    return 0;
+}
+
+// Run fn() once and print its throughput in 'unit's per second, wall time and peak RSS.
+template<typename Fn>
+void benchmark(const string &name, size_t items, const char *unit, Fn fn) {
+    resetPeakRss();
+    auto begin = chrono::steady_clock::now();
+    fn();
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+    long peak = peakRssKiB();
+
+    ios savedFormat(nullptr);
+    savedFormat.copyfmt(cout);
+    cout << "  " << left << setw(34) << name << right << fixed << setprecision(0)
+         << setw(14) << items / max(seconds, 1e-9) << ' ' << left << setw(13) << (string(unit) + "/s") << right
+         << setprecision(1) << setw(10) << seconds * 1000 << " ms" << setw(10) << peak / 1024.0 << " MiB peak\n";
+    cout.copyfmt(savedFormat);
+}
+
+int runBench(size_t maxLines) {
+    fs::path scratch = fs::temp_directory_path() / ("stateprofile-bench-" + to_string(getpid()));
+    string dir = scratch.string() + "/";
+    string heartRatePath = dir + "heart_rate.txt", tempPath = dir + "temperature.txt", motionPath = dir + "motion.txt";
+    string candidatesDir = dir + "candidates/", cacheDir = dir + "cache/";
+    error_code ec;
+    fs::create_directories(scratch, ec);
+    if (ec) {
+        cerr << "Error: Could not create " << dir << ": " << ec.message() << endl;
+        return 1;
+    }
+    cout << "Scratch directory: " << dir << "\n"
+         << "Sensor kernels: " << sensorKernels().name << ", hardware threads: " << thread::hardware_concurrency() << "\n";
+
+    string logBuffer; // Reused across runs, as a daemon would.
+    for (size_t lines = BENCH_MIN_LINES; lines <= maxLines; lines *= 10) {
+        cout << "\n" << lines << " lines per log:\n";
+        writeSyntheticLogs(heartRatePath, tempPath, motionPath, lines);
+
+        benchmark("computeHeartRateAverages (text)", lines, "lines", [&] {
+            benchSink = computeHeartRateAverages(readLogSnapshot(heartRatePath, logBuffer)).first;
+        });
+        benchmark("computeTemperatureAverages (text)", lines, "lines", [&] {
+            benchSink = computeTemperatureAverages(readLogSnapshot(tempPath, logBuffer)).first;
+        });
+        benchmark("  streaming median", lines, "lines", [&] {
+            benchSink = computeTemperatureAverages(readLogSnapshot(tempPath, logBuffer), true).first;
+        });
+        benchmark("computeBestMotionValue (text)", lines, "lines", [&] {
+            benchSink = computeBestMotionValue(readLogSnapshot(motionPath, logBuffer));
+        });
+
+        benchmark("convert logs to binary", 3 * lines, "lines", [&] {
+            convertTextLogToBinary(heartRatePath, SensorKind::HeartRate, false);
+            convertTextLogToBinary(tempPath, SensorKind::Temperature, false);
+            convertTextLogToBinary(motionPath, SensorKind::Motion, false);
+        });
+        benchmark("computeHeartRateAverages (binary)", lines, "records", [&] {
+            benchSink = computeHeartRateAverages(BinaryLogReader(binaryLogPath(heartRatePath), SensorKind::HeartRate)).first;
+        });
+        benchmark("computeTemperatureAverages (binary)", lines, "records", [&] {
+            benchSink = computeTemperatureAverages(BinaryLogReader(binaryLogPath(tempPath), SensorKind::Temperature)).first;
+        });
+        benchmark("computeBestMotionValue (binary)", lines, "records", [&] {
+            benchSink = computeBestMotionValue(BinaryLogReader(binaryLogPath(motionPath), SensorKind::Motion));
+        });
+
+        size_t candidates = min(lines, BENCH_MAX_CANDIDATES);
+        writeSyntheticCandidates(candidatesDir, "word", candidates);
+        writeEdgeCaseCandidates(candidatesDir, "word");
+        fs::remove_all(cacheDir, ec);
+        CandidateIndex index;
+        benchmark("loadCandidateIndex (rebuild)", candidates, "candidates", [&] {
+            index = loadCandidateIndex(candidatesDir, "word", cacheDir);
+        });
+        benchmark("loadCandidateIndex (cached)", candidates, "candidates", [&] {
+            index = loadCandidateIndex(candidatesDir, "word", cacheDir);
+        });
+        // Selection is timed over a spread of readings, as a daemon would issue them.
+        vector<SensorReading> readings(BENCH_QUERIES);
+        mt19937_64 rng(BENCH_QUERIES);
+        uniform_real_distribution<double> heart(55.0, 120.0), objectT(35.5, 38.5), ambient(15.0, 30.0), spo2(92.0, 99.0);
+        for (SensorReading &r : readings) r = { heart(rng), objectT(rng), ambient(rng), spo2(rng) };
+        benchmark("selectTopCandidates", candidates * BENCH_QUERIES, "candidates", [&] {
+            for (const SensorReading &r : readings) benchSink = selectTopCandidates(index, r, 10).front().second;
+        });
+        benchmark("selectTopCandidates (full scan)", candidates * BENCH_QUERIES, "candidates", [&] {
+            for (const SensorReading &r : readings) {
+                TopK best(10);
+                offerAllCandidates(index, r, best);
+                benchSink = best.sortedDescending().front().first;
+            }
+        });
+        benchmark("selectBestBodyLanguage", candidates * BENCH_QUERIES, "candidates", [&] {
+            for (const SensorReading &r : readings) benchSink = selectBestBodyLanguage(index, r[0] / 60.0).second;
+        });
+
+        // The timed readings, plus readings on the edge cases' bounds and ones that are not finite.
+        readings.push_back({ 85.0, 37.0, 20.0, 96.0 });
+        readings.push_back({ 75.0, 37.0, 22.0, 97.0 });
+        readings.push_back({ 80.0, 36.5, 1e300, 93.0 });
+        readings.push_back({ NAN, 37.0, 22.0, 97.0 });
+        readings.push_back({ 75.0, INFINITY, 22.0, -INFINITY });
+        if (!selectionMatchesFullScan(index, readings)) {
+            fs::remove_all(scratch, ec);
+            return 1;
+        }
+    }
+    fs::remove_all(scratch, ec);
+    return 0;
+}
+
+// ---------------------------
+// Command-Line Options
+// ---------------------------
+struct Options {
+    bool streamingMedian = false; // --streaming-median: bounded-memory P-square temperature medians.
+    bool exportDocx = false;      // --docx: also write state_profile.docx through pandoc.
+    bool legacyRender = false;    // --legacy-render: make the JPG with pandoc, LibreOffice and ImageMagick.
+    bool converterDaemon = false; // --converter-daemon: legacy render through a persistent LibreOffice.
+    bool daemon = false;          // --daemon: stay running and regenerate whenever the inputs change.
+    int windowSeconds = 0;        // --window=SECONDS: daemon aggregates cover only the last SECONDS.
+    bool convertLogs = false;     // --convert-logs: write binary copies of the text sensor logs and exit.
+    bool timingReport = false;    // --timing-report: record stage and tool latencies into TIMING_DIR.
+    size_t benchLines = 0;        // --bench[=MAX_LINES]: benchmark on synthetic data and exit.
+    string batchManifest;         // --batch=MANIFEST: one profile per subject of MANIFEST.
+    size_t batchJobs = 0;         // --jobs=N: subjects a batch generates at once; 0 picks a default.
+};
+
+void printUsage(const char *program) {
+    cerr << "Usage: " << program << " [--streaming-median] [--docx] [--legacy-render] [--converter-daemon] [--daemon [--window=SECONDS]]\n"
+         << "       " << string(strlen(program), ' ') << " [--batch=MANIFEST [--jobs=N]] [--timing-report]\n"
+         << "       " << program << " --convert-logs\n"
+         << "       " << program << " --bench[=MAX_LINES]\n";
+}
+
+// Longest --window: the sliding window keeps one bucket per second.
+const int MAX_WINDOW_SECONDS = 24 * 60 * 60;
+
+// Most --jobs: each job is a whole profile with its own stage threads.
+const size_t MAX_BATCH_JOBS = 64;
+
+// Parse all of 'text' as an unsigned integer in [low, high].
+template<typename T>
+bool parseNumberInRange(string_view text, T low, T high, T &value) {
+    T parsed;
+    auto [next, ec] = from_chars(text.data(), text.data() + text.size(), parsed);
+    if (ec != errc() || next != text.data() + text.size() || parsed < low || parsed > high) return false;
+    value = parsed;
+    return true;
+}
+
+// Returns false on an unknown option.
+bool parseOptions(int argc, char *argv[], Options &options) {
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "--streaming-median") {
+            options.streamingMedian = true;
+        } else if (arg == "--docx") {
+            options.exportDocx = true;
+        } else if (arg == "--legacy-render") {
+            options.legacyRender = true;
+            options.exportDocx = true; // The legacy JPG is converted from the DOCX.
+        } else if (arg == "--daemon") {
+            options.daemon = true;
+        } else if (arg.rfind("--window=", 0) == 0) {
+            if (!parseNumberInRange(string_view(arg).substr(strlen("--window=")), 1, MAX_WINDOW_SECONDS, options.windowSeconds)) {
+                cerr << "Error: --window needs between 1 and " << MAX_WINDOW_SECONDS << " seconds." << endl;
+                return false;
+            }
+        } else if (arg == "--bench") {
+            options.benchLines = BENCH_DEFAULT_LINES;
+        } else if (arg.rfind("--bench=", 0) == 0) {
+            if (!parseNumberInRange(string_view(arg).substr(strlen("--bench=")), BENCH_MIN_LINES, BENCH_MAX_LINES, options.benchLines)) {
+                cerr << "Error: --bench needs between " << BENCH_MIN_LINES << " and " << BENCH_MAX_LINES << " lines." << endl;
+                return false;
+            }
+        } else if (arg.rfind("--batch=", 0) == 0) {
+            options.batchManifest = arg.substr(strlen("--batch="));
+        } else if (arg.rfind("--jobs=", 0) == 0) {
+            if (!parseNumberInRange(string_view(arg).substr(strlen("--jobs=")), size_t(1), MAX_BATCH_JOBS, options.batchJobs)) {
+                cerr << "Error: --jobs needs between 1 and " << MAX_BATCH_JOBS << " subjects." << endl;
+                return false;
+            }
+        } else if (arg == "--timing-report") {
+            options.timingReport = true;
+        } else if (arg == "--convert-logs") {
+            options.convertLogs = true;
+        } else if (arg == "--converter-daemon") {
+            options.converterDaemon = options.legacyRender = options.exportDocx = true;
+        } else {
+            cerr << "Error: unknown option '" << arg << "'." << endl;
+            return false;
+        }
+    }
+    if (options.daemon && !options.batchManifest.empty()) {
+        cerr << "Error: --batch and --daemon cannot be combined." << endl;
+        return false;
+    }
+    if (options.batchJobs > 0 && options.batchManifest.empty()) {
+        cerr << "Error: --jobs only applies to --batch." << endl;
+        return false;
+    }
+    if (options.windowSeconds > 0 && !options.daemon) {
+        cerr << "Error: --window only applies to --daemon." << endl;
+        return false;
+    }
+    return true;
+}
+
+// ---------------------------
+// Main Process
+// ---------------------------
+// Sensor values that were already aggregated elsewhere (daemon mode).
+struct SensorSummary {
+    double avgBPM = NAN, avgSpO2 = NAN;
+    double avgAmbient = NAN, avgObject = NAN;
+    double bestMotion = NAN;
+};
+
+// Inputs and outputs of one subject. The defaults are the single-subject paths; batch mode
+// gives every subject its own.
+struct SubjectPaths {
+    string heartRateLog = HEART_RATE_LOG;
+    string tempLog = TEMP_LOG;
+    string motionLog = MOTION_LOG;
+    string logFile = LOG_FILE;
+    string finalImg = FINAL_IMG_NAME;
+    string finalDocx = OUTPUT_DIR + "state_profile.docx";
+    string logScreenshot = LOG_SCREENSHOT;
+    string cameraImage = CAMERA_IMAGE; // Empty for a subject without the USB camera.
+    string outputSet = "profile";      // Names the manifest of what it published, see collectOldOutputs().
+};
+
+// The three compiled candidate directories.
+struct CandidateIndexes {
+    CandidateIndex coreWords, coreEmotions, bodyLanguage;
+};
+
+CandidateIndexes loadCandidateIndexes() {
+    auto words = async(launch::async, [] { return loadCandidateIndex(CORE_WORDS_DIR, "word"); });
+    auto emotions = async(launch::async, [] { return loadCandidateIndex(CORE_EMOTIONS_DIR, "emotion"); });
+    CandidateIndexes indexes;
+    indexes.bodyLanguage = loadCandidateIndex(BODY_LANGUAGE_DIR, "position");
+    indexes.coreWords = words.get();
+    indexes.coreEmotions = emotions.get();
+    return indexes;
+}
+
+// Serializes the per-run reports of concurrent batch subjects.
+mutex consoleMutex;
+
+// Build the whole state profile of 'subject' once and publish it. With 'sharedIndexes' the
+// candidate directories are not loaded again, and with 'liveSensors' the sensor stage just
+// takes those values instead of processing the logs. The caller hands the result to
+// finishProfileRuns().
+PublishedProfile generateProfile(const Options &options, const SubjectPaths &subject = SubjectPaths(),
+                                 const CandidateIndexes *sharedIndexes = nullptr,
+                                 const SensorSummary *liveSensors = nullptr) {
+    auto start = chrono::high_resolution_clock::now();
+    
+    // Define final file paths. Everything is written to the staging directory first.
+    const string &finalDocx = subject.finalDocx;
+    const string &finalImg = subject.finalImg;
+    PublishedProfile published { createStagingDir(), subject.outputSet, {} };
+    const string &stagingDir = published.stagingDir;
+    auto staged = [&](const string &finalPath) { return stagingDir + fs::path(finalPath).filename().string(); };
+    bool useCamera = !subject.cameraImage.empty();
+    
+    // Stage results. Each one is written by exactly one task and read only by its dependents.
+    CandidateIndexes loadedIndexes;
+    const CandidateIndexes &indexes = sharedIndexes ? *sharedIndexes : loadedIndexes;
+    pair<double, double> heartRate, temperature;
+    double bestMotion = NAN;
+    vector<pair<string, double>> topCoreWords, topCoreEmotions;
+    pair<string, double> bestBodyLanguage;
+    string logText;
+    ProfileDocument doc;
+    
+    TaskGraph pipeline;
+    
+    // The candidate indexes don't depend on the sensor data, so a rebuild overlaps with the
+    // log processing.
+    auto wordsIndexTask = pipeline.add("index core words", {}, [&] {
+        if (!sharedIndexes) loadedIndexes.coreWords = loadCandidateIndex(CORE_WORDS_DIR, "word");
+    });
+    auto emotionsIndexTask = pipeline.add("index core emotions", {}, [&] {
+        if (!sharedIndexes) loadedIndexes.coreEmotions = loadCandidateIndex(CORE_EMOTIONS_DIR, "emotion");
+    });
+    auto bodyIndexTask = pipeline.add("index body language", {}, [&] {
+        if (!sharedIndexes) loadedIndexes.bodyLanguage = loadCandidateIndex(BODY_LANGUAGE_DIR, "position");
+    });
+    
+    // The three sensor logs, binary or text; each one is processed in parallel chunks.
+    auto heartRateTask = pipeline.add("heart rate", {}, [&] {
+        heartRate = liveSensors ? make_pair(liveSensors->avgBPM, liveSensors->avgSpO2)
+                                : heartRateFromLog(subject.heartRateLog);
+    });
+    auto motionTask = pipeline.add("motion", {}, [&] {
+        bestMotion = liveSensors ? liveSensors->bestMotion : bestMotionFromLog(subject.motionLog);
+    });
+    auto tempTask = pipeline.add("temperature", {}, [&] {
+        temperature = liveSensors ? make_pair(liveSensors->avgAmbient, liveSensors->avgObject)
+                                  : temperatureFromLog(subject.tempLog, options.streamingMedian);
+    });
+    
+    // Candidate selection, one task per directory.
+    // Words and emotions match every reading against its own range.
+    auto reading = [&] {
+        return SensorReading{ heartRate.first, temperature.second, temperature.first, heartRate.second };
+    };
+    auto wordsTask = pipeline.add("select core words", { wordsIndexTask, heartRateTask, tempTask }, [&] {
+        topCoreWords = selectTopCandidates(indexes.coreWords, reading(), 10);
+    });
+    auto emotionsTask = pipeline.add("select core emotions", { emotionsIndexTask, heartRateTask, tempTask }, [&] {
+        topCoreEmotions = selectTopCandidates(indexes.coreEmotions, reading(), 10);
+    });
+    auto bodyTask = pipeline.add("select body language", { bodyIndexTask, motionTask }, [&] {
+        bestBodyLanguage = selectBestBodyLanguage(indexes.bodyLanguage, bestMotion);
+    });
+    
+    auto readLogTask = pipeline.add("read log", {}, [&] {
+        logText = readFileContents(subject.logFile);
+        if (logText.empty()) logText = "No log data available.";
+    });
+    
+    // Capture USB camera snapshot.
+    auto cameraTask = pipeline.add("camera", {}, [&] {
+        if (useCamera && isCameraDetected())
+            captureCameraSnapshot(staged(subject.cameraImage));
+    });
+    
+    // The log is read once by "read log" and shared with the document.
+    auto logScreenshotTask = pipeline.add("log screenshot", { readLogTask }, [&] {
+        writeLogScreenshot(subject.logFile, logText, staged(subject.logScreenshot), options.legacyRender);
+    });
+    
+    // Build the document.
+    auto docTask = pipeline.add("build document", { wordsTask, emotionsTask, bodyTask, readLogTask }, [&] {
+        doc = buildProfileDocument(topCoreWords, topCoreEmotions, bestBodyLanguage, heartRate.first, heartRate.second,
+                                   temperature.first, temperature.second, bestMotion, logText);
+    });
+    
+    // Optional DOCX export (directly from Markdown content), then the final image.
+    auto docxTask = pipeline.add("docx export", { docTask }, [&] {
+        if (options.exportDocx)
+            createDocxDirectly(staged(finalDocx), toMarkdown(doc));
+    });
+    auto renderTask = pipeline.add("render profile", { docTask, docxTask }, [&] {
+        if (options.legacyRender)
+            convertDocxToJpg(staged(finalDocx), staged(finalImg), options.converterDaemon);
+        else
+            writeJpeg(staged(finalImg), renderDocument(doc));
+    });
+    
+    // Swap the finished files into OUTPUT_DIR; the previous outputs are collected later.
+    pipeline.add("publish", { cameraTask, logScreenshotTask, docxTask, renderTask }, [&] {
+        waitForOutputCollection();
+        published.files = publishStagedOutputs(stagingDir, fs::path(finalImg).filename().string());
+    });
+    
+    pipeline.run();
+    
+    // Error stacking.
+    vector<pair<string,int>> errors;
+    if (topCoreWords.empty()) errors.push_back({"NO CORE WORDS DETECTED", ERR_NO_CORE_WORDS});
+    if (topCoreEmotions.empty()) errors.push_back({"NO CORE EMOTIONS DETECTED", ERR_NO_CORE_EMOTIONS});
+    if (bestBodyLanguage.first.empty()) errors.push_back({"NO BODY LANGUAGE DETECTED", ERR_NO_BODY_LANG});
+    if (useCamera && !isCameraDetected()) errors.push_back({"USB CAMERA NOT DETECTED", ERR_NO_CAMERA});
+    
+    auto end = chrono::high_resolution_clock::now();
+    auto duration = chrono::duration_cast<chrono::milliseconds>(end - start).count();
+    
+    if (timingRecorder().isEnabled())
+        timingRecorder().record("total", chrono::duration<double, milli>(end - start).count());
+    
+    // A failed render or publish leaves the previous profile in OUTPUT_DIR.
+    bool imagePublished = published.files.count(fs::path(finalImg).filename().string()) > 0;
+    if (!imagePublished) errors.push_back({"PROFILE IMAGE NOT WRITTEN", ERR_NO_PROFILE_IMAGE});
+
+    ostringstream report;
+    report << "State profile generated in " << duration << "ms.\n";
+    pipeline.printTimings(report);
+    if (options.exportDocx) report << "DOCX: " << finalDocx << "\n";
+    report << "JPG: " << finalImg << (imagePublished ? "" : " (not updated)") << "\n";
+    
+    if (!errors.empty()) {
+        report << "\nErrors Detected:\n";
+        for (const auto &err : errors)
+            report << err.first << " [Code: " << err.second << "]\n";
+    }
+    lock_guard<mutex> lock(consoleMutex);
+    cout << report.str();
+    return published;
+}
+
+// After one or more generateProfile() calls: collect the outputs they replaced and, with
+// --timing-report, write the report for everything they recorded.
+void finishProfileRuns(vector<PublishedProfile> runs) {
+    collectOldOutputs(move(runs));
+    if (timingRecorder().isEnabled()) {
+        writeTimingReport(timingRecorder().take());
+        cout << "Timing report: " << TIMING_REPORT << "\n";
+    }
+}
+
+// ---------------------------
+// Daemon Mode
+// ---------------------------
+// With --daemon the process stays up instead of being started by cron every minute. The
+// sensor logs are tailed: each LogTail remembers how far its file has been read, and inotify
+// wakes the loop when a log, LOG_FILE or a candidate directory changes. New lines update
+// rolling aggregates, so an update costs O(new lines), and the profile is only regenerated
+// when an input actually changed. The camera also stays open between updates.
+//
+// The rolling aggregates are exact for the means, standard deviations and motion minimum.
+// The 2-sigma heart-rate filter is applied to a uniform reservoir sample of the samples,
+// and the temperature medians are P-square estimates, as with --streaming-median.
+const size_t HEART_RATE_RESERVOIR_SIZE = 4096;
+// After the first event, wait this long for a burst of writes to finish.
+const auto DAEMON_SETTLE_TIME = chrono::milliseconds(200);
+
+class LogTail {
+public:
+    explicit LogTail(string filePath) : path(move(filePath)) {}
+
+    // Call onLine for every complete, non-empty line appended since the last call. If the file
+    // was truncated or replaced (log rotation), onReset runs first and the file is re-read from
+    // the start. Returns true if anything changed. A trailing line without its newline yet is
+    // held back until the rest of it arrives.
+    template<typename LineFn, typename ResetFn>
+    bool poll(LineFn onLine, ResetFn onReset) {
+        struct stat st;
+        if (stat(path.c_str(), &st) != 0) return false;
+        bool changed = false;
+        if (st.st_ino != inode || st.st_size < offset) {
+            if (inode != 0) {
+                onReset();
+                changed = true;
+            }
+            inode = st.st_ino;
+            offset = 0;
+            partial.clear();
+        }
+        if (st.st_size == offset) return changed;
+
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return changed;
+        char buffer[1 << 16];
+        ssize_t n;
+        while ((n = pread(fd, buffer, sizeof(buffer), offset)) > 0) {
+            offset += n;
+            changed = true;
+            const char *p = buffer, *end = buffer + n;
+            while (p < end) {
+                const char *nl = static_cast<const char *>(memchr(p, '\n', end - p));
+                if (!nl) {
+                    partial.append(p, end - p);
+                    break;
+                }
+                if (partial.empty()) {
+                    if (nl > p) onLine(string_view(p, nl - p));
+                } else {
+                    partial.append(p, nl - p);
+                    onLine(string_view(partial));
+                    partial.clear();
+                }
+                p = nl + 1;
+            }
+        }
+        ::close(fd);
+        return changed;
+    }
+
+private:
+    string path;
+    ino_t inode = 0;
+    off_t offset = 0;
+    string partial;
+};
+
+class RollingHeartRate {
+public:
+    void add(double bpm, double spo2) {
+        bpmStats.add(bpm);
+        spo2Stats.add(spo2);
+        // Algorithm R: every sample seen so far is in the reservoir with equal probability.
+        if (reservoir.size() < HEART_RATE_RESERVOIR_SIZE) {
+            reservoir.push_back({ bpm, spo2 });
+        } else {
+            size_t slot = uniform_int_distribution<size_t>(0, bpmStats.count - 1)(rng);
+            if (slot < HEART_RATE_RESERVOIR_SIZE) reservoir[slot] = { bpm, spo2 };
+        }
+    }
+
+    pair<double, double> averages() const {
+        if (bpmStats.count == 0) return {NAN, NAN};
+        double limitBPM = 2 * bpmStats.stddev(), limitSpO2 = 2 * spo2Stats.stddev();
+        KeptSum keptBPM, keptSpO2;
+        for (const auto &[bpm, spo2] : reservoir) {
+            if (fabs(bpm - bpmStats.mean) <= limitBPM) { keptBPM.sum += bpm; ++keptBPM.count; }
+            if (fabs(spo2 - spo2Stats.mean) <= limitSpO2) { keptSpO2.sum += spo2; ++keptSpO2.count; }
+        }
+        return { keptBPM.count ? keptBPM.sum / keptBPM.count : bpmStats.mean,
+                 keptSpO2.count ? keptSpO2.sum / keptSpO2.count : spo2Stats.mean };
+    }
+
+private:
+    RunningStats bpmStats, spo2Stats;
+    vector<pair<double, double>> reservoir;
+    mt19937_64 rng { 42 };
+};
+
+struct RollingTemperature {
+    P2Quantile ambientMedian { 0.5 }, objectMedian { 0.5 };
+
+    void add(double ambient, double objectT) {
+        ambientMedian.add(ambient);
+        objectMedian.add(objectT);
+    }
+};
+
+struct RollingMotion {
+    double bestSumOfSquares = INFINITY;
+
+    void add(double gx, double gy, double gz) {
+        bestSumOfSquares = min(bestSumOfSquares, gx * gx + gy * gy + gz * gz);
+    }
+    double bestRMS() const { return isinf(bestSumOfSquares) ? NAN : sqrt(bestSumOfSquares / 3.0); }
+};
+
+// Sliding-window aggregation (--window=SECONDS). Instead of everything ever logged, the
+// profile reflects only the last SECONDS. Samples are pre-aggregated into one bucket per
+// second in a ring buffer; a slot is recycled when its second falls out of the window, so
+// expiry is O(1), and a summary scans a fixed number of buckets whatever the log size.
+// The log lines carry no timestamps, so a sample is stamped with the second it is read in,
+// as in the binary logs the daemon keeps. At startup the window is refilled from those; if
+// they can't be written, the backlog is stamped with the startup time and ages out after
+// one window.
+struct SensorBucket {
+    int64_t second = -1; // Which second this slot currently holds; -1 if never used.
+    RunningStats bpm, spo2;
+    size_t temperatureCount = 0;
+    double ambientSum = 0.0, objectSum = 0.0;
+    double bestSumOfSquares = INFINITY;
+};
+
+class SlidingWindow {
+public:
+    explicit SlidingWindow(int seconds) : ring(seconds) {}
+
+    int seconds() const { return int(ring.size()); }
+
+    void addHeartRate(int64_t now, double bpm, double spo2) {
+        SensorBucket &b = bucket(now);
+        b.bpm.add(bpm);
+        b.spo2.add(spo2);
+    }
+
+    void addTemperature(int64_t now, double ambient, double objectT) {
+        SensorBucket &b = bucket(now);
+        ++b.temperatureCount;
+        b.ambientSum += ambient;
+        b.objectSum += objectT;
+    }
+
+    void addMotion(int64_t now, double gx, double gy, double gz) {
+        SensorBucket &b = bucket(now);
+        b.bestSumOfSquares = min(b.bestSumOfSquares, gx * gx + gy * gy + gz * gz);
+    }
+
+    // Summary over the buckets still inside the window at 'now'. At bucket granularity:
+    // the 2-sigma heart-rate filter drops whole seconds whose mean is an outlier, and the
+    // temperature medians are medians of the per-second means.
+    SensorSummary summarize(int64_t now) const {
+        vector<const SensorBucket *> live;
+        for (const SensorBucket &b : ring)
+            if (b.second > now - (int64_t)ring.size() && b.second <= now) live.push_back(&b);
+
+        SensorSummary summary;
+        // The per-second statistics are merged with Chan's formula, as the log chunks are.
+        auto filteredMean = [&](RunningStats SensorBucket::*stats) {
+            RunningStats all;
+            for (const SensorBucket *b : live) all.merge(b->*stats);
+            if (all.count == 0) return (double)NAN;
+            double limit = 2 * all.stddev();
+            RunningStats kept;
+            for (const SensorBucket *b : live) {
+                const RunningStats &second = b->*stats;
+                if (second.count && fabs(second.mean - all.mean) <= limit) kept.merge(second);
+            }
+            return kept.count ? kept.mean : all.mean;
+        };
+        summary.avgBPM = filteredMean(&SensorBucket::bpm);
+        summary.avgSpO2 = filteredMean(&SensorBucket::spo2);
+
+        vector<double> ambients, objects;
+        for (const SensorBucket *b : live) {
+            if (b->temperatureCount) {
+                ambients.push_back(b->ambientSum / b->temperatureCount);
+                objects.push_back(b->objectSum / b->temperatureCount);
+            }
+            summary.bestMotion = fmin(summary.bestMotion, sqrt(b->bestSumOfSquares / 3.0));
+        }
+        if (!ambients.empty()) {
+            summary.avgAmbient = selectMedian(ambients);
+            summary.avgObject = selectMedian(objects);
+        }
+        if (isinf(summary.bestMotion)) summary.bestMotion = NAN;
+        return summary;
+    }
+
+private:
+    // The slot for second 'now', cleared first if it still holds an expired second.
+    SensorBucket &bucket(int64_t now) {
+        SensorBucket &b = ring[now % ring.size()];
+        if (b.second != now) {
+            b = SensorBucket();
+            b.second = now;
+        }
+        return b;
+    }
+
+    vector<SensorBucket> ring;
+};
+
+// Wall-clock time, since the stamps outlive the daemon in the binary logs.
+int64_t currentTimeMs() {
+    return chrono::duration_cast<chrono::milliseconds>(chrono::system_clock::now().time_since_epoch()).count();
+}
+
+// The daemon is the producer of the binary logs: every sample it tails is appended, stamped
+// with the time it was read, and flush() after each poll writes it out, so the binary logs
+// stay as current as the text logs and one-shot runs read them instead. A binary log that is
+// empty when the daemon starts is seeded with its text log's backlog, stamped with the text
+// log's mtime as --convert-logs does; otherwise an earlier run already recorded the backlog.
+// Lines logged while no daemon ran reach the binary logs only through --convert-logs.
+class SensorArchive {
+public:
+    SensorArchive()
+        : heartRate(HEART_RATE_LOG, SensorKind::HeartRate), temperature(TEMP_LOG, SensorKind::Temperature),
+          motion(MOTION_LOG, SensorKind::Motion) {}
+
+    bool ok() const { return heartRate.writer.ok() && temperature.writer.ok() && motion.writer.ok(); }
+
+    // Add one sample of 'kind'; 'record' holds sensorFieldCount(kind) values.
+    void add(SensorKind kind, int64_t timestampMs, const double *record) {
+        Sensor &s = kind == SensorKind::HeartRate ? heartRate : kind == SensorKind::Temperature ? temperature : motion;
+        if (inBacklog) {
+            if (!s.takeBacklog) return;
+            timestampMs = s.backlogStampMs;
+        }
+        s.writer.append(timestampMs, record);
+    }
+
+    // Write out the buffered samples. The first call also ends the startup backlog.
+    void flush() {
+        inBacklog = false;
+        for (Sensor *s : { &heartRate, &temperature, &motion }) s->writer.flush();
+    }
+
+private:
+    struct Sensor {
+        Sensor(const string &textPath, SensorKind kind) : writer(binaryLogPath(textPath), kind) {
+            struct stat st;
+            takeBacklog = writer.ok() && writer.empty() && stat(textPath.c_str(), &st) == 0;
+            if (takeBacklog) backlogStampMs = modificationTimeMs(st);
+        }
+
+        BinaryLogWriter writer;
+        bool takeBacklog;
+        int64_t backlogStampMs = 0;
+    };
+
+    Sensor heartRate, temperature, motion;
+    bool inBacklog = true;
+};
+
+// Call fn(timestampMs, block, i) for every record of 'log' stamped at or after 'sinceMs'.
+// The block index skips the older blocks without decoding them.
+template<int Fields, typename Fn>
+void forEachBinaryRecordSince(const BinaryLogReader &log, int64_t sinceMs, Fn fn) {
+    SampleBlock<Fields> block;
+    int64_t timestamps[SAMPLE_BLOCK_SIZE];
+    for (size_t b = log.seek(sinceMs); b < log.blockCount(); ++b) {
+        if (!log.readBlock(b, block, timestamps)) continue;
+        for (size_t i = 0; i < block.size; ++i)
+            if (timestamps[i] >= sinceMs) fn(timestamps[i], block, i);
+    }
+}
+
+// Refill 'window' with what the binary logs recorded during its last seconds up to 'nowMs'.
+void seedWindowFromBinaryLogs(SlidingWindow &window, int64_t nowMs) {
+    int64_t sinceMs = (nowMs / 1000 - window.seconds() + 1) * 1000;
+    forEachBinaryRecordSince<2>(BinaryLogReader(binaryLogPath(HEART_RATE_LOG), SensorKind::HeartRate), sinceMs,
+                                [&](int64_t ms, const SampleBlock<2> &b, size_t i) {
+        window.addHeartRate(ms / 1000, b.column[0][i], b.column[1][i]);
+    });
+    forEachBinaryRecordSince<2>(BinaryLogReader(binaryLogPath(TEMP_LOG), SensorKind::Temperature), sinceMs,
+                                [&](int64_t ms, const SampleBlock<2> &b, size_t i) {
+        window.addTemperature(ms / 1000, b.column[0][i], b.column[1][i]);
+    });
+    forEachBinaryRecordSince<6>(BinaryLogReader(binaryLogPath(MOTION_LOG), SensorKind::Motion), sinceMs,
+                                [&](int64_t ms, const SampleBlock<6> &b, size_t i) {
+        window.addMotion(ms / 1000, b.column[3][i], b.column[4][i], b.column[5][i]);
+    });
+}
+
+// Read whatever was appended to the three sensor logs into the rolling aggregates, into
+// 'window' as well when sliding-window mode is on, and into 'archive' if given. Returns true
+// if any log changed.
+bool updateSensorAggregates(LogTail &heartRateTail, LogTail &tempTail, LogTail &motionTail,
+                            RollingHeartRate &heartRate, RollingTemperature &temperature, RollingMotion &motion,
+                            SlidingWindow *window, SensorArchive *archive) {
+    int64_t nowMs = currentTimeMs(), now = nowMs / 1000;
+    bool changed = false;
+    double r[MAX_SENSOR_FIELDS];
+    changed |= heartRateTail.poll([&](string_view line) {
+        if (parseHeartRateLine(line, r[0], r[1])) {
+            heartRate.add(r[0], r[1]);
+            if (window) window->addHeartRate(now, r[0], r[1]);
+            if (archive) archive->add(SensorKind::HeartRate, nowMs, r);
+        }
+    }, [&] { heartRate = RollingHeartRate(); });
+    changed |= tempTail.poll([&](string_view line) {
+        if (parseTemperatureLine(line, r[0], r[1])) {
+            temperature.add(r[0], r[1]);
+            if (window) window->addTemperature(now, r[0], r[1]);
+            if (archive) archive->add(SensorKind::Temperature, nowMs, r);
+        }
+    }, [&] { temperature = RollingTemperature(); });
+    changed |= motionTail.poll([&](string_view line) {
+        if (parseMotionLine(line, r[0], r[1], r[2], r[3], r[4], r[5])) {
+            motion.add(r[3], r[4], r[5]);
+            if (window) window->addMotion(now, r[3], r[4], r[5]);
+            if (archive) archive->add(SensorKind::Motion, nowMs, r);
+        }
+    }, [&] { motion = RollingMotion(); });
+    if (archive) archive->flush();
+    return changed;
+}
+
+// Block until an inotify event concerning a file in 'files' or a directory in 'anyChangeDirs'
+// arrives, let the burst settle, and drain the queue. Other events, such as the daemon's own
+// binary log writes, are drained and waited past. Returns false once 'timeoutMs' passes
+// (-1 for never) without a relevant event.
+bool waitForInputChange(int inotifyFd, const map<int, string> &watchDirs,
+                        const set<string> &files, const set<string> &anyChangeDirs, int64_t timeoutMs = -1) {
+    auto deadline = chrono::steady_clock::now() + chrono::milliseconds(max<int64_t>(timeoutMs, 0));
+    for (;;) {
+        int64_t waitMs = -1;
+        if (timeoutMs >= 0)
+            waitMs = max<int64_t>(0, chrono::duration_cast<chrono::milliseconds>(deadline - chrono::steady_clock::now()).count());
+        pollfd pfd { inotifyFd, POLLIN, 0 };
+        if (::poll(&pfd, 1, int(min<int64_t>(waitMs, numeric_limits<int>::max()))) <= 0) return false;
+        this_thread::sleep_for(DAEMON_SETTLE_TIME);
+
+        bool relevant = false;
+        alignas(inotify_event) char buffer[16 * 1024];
+        ssize_t n;
+        while ((n = read(inotifyFd, buffer, sizeof(buffer))) > 0) {
+            for (char *p = buffer; p < buffer + n; ) {
+                const inotify_event *event = reinterpret_cast<const inotify_event *>(p);
+                auto dir = watchDirs.find(event->wd);
+                if (dir != watchDirs.end()) {
+                    if (anyChangeDirs.count(dir->second)) relevant = true;
+                    else if (event->len > 0 && files.count((fs::path(dir->second) / event->name).string())) relevant = true;
+                }
+                p += sizeof(inotify_event) + event->len;
+            }
+        }
+        if (relevant) return true;
+    }
+}
+
+int runDaemon(const Options &options) {
+    int inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotifyFd < 0) {
+        cerr << "Error: inotify unavailable: " << strerror(errno) << endl;
+        return 1;
+    }
+    // Watch the directories rather than the files, so rotated or re-created logs are noticed.
+    set<string> files = { HEART_RATE_LOG, TEMP_LOG, MOTION_LOG, LOG_FILE };
+    set<string> anyChangeDirs;
+    for (const string &dir : { CORE_WORDS_DIR, CORE_EMOTIONS_DIR, BODY_LANGUAGE_DIR })
+        anyChangeDirs.insert(fs::path(dir).parent_path().string());
+    set<string> dirs = anyChangeDirs;
+    for (const string &file : files) dirs.insert(fs::path(file).parent_path().string());
+
+    const uint32_t mask = IN_MODIFY | IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO;
+    map<int, string> watchDirs;
+    for (const string &dir : dirs) {
+        int wd = inotify_add_watch(inotifyFd, dir.c_str(), mask);
+        if (wd < 0)
+            cerr << "Warning: cannot watch " << dir << ": " << strerror(errno) << endl;
+        else
+            watchDirs[wd] = dir;
+    }
+
+    LogTail heartRateTail(HEART_RATE_LOG), tempTail(TEMP_LOG), motionTail(MOTION_LOG);
+    RollingHeartRate heartRate;
+    RollingTemperature temperature;
+    RollingMotion motion;
+    unique_ptr<SlidingWindow> window;
+    if (options.windowSeconds > 0) window = make_unique<SlidingWindow>(options.windowSeconds);
+    SensorArchive archive;
+    if (!archive.ok()) cerr << "Warning: Not keeping the binary sensor logs." << endl;
+    SensorArchive *archiveIfOk = archive.ok() ? &archive : nullptr;
+
+    // The first pass reads the logs in full; afterwards only what gets appended. The window
+    // then comes from the binary logs, whose records carry the time they were read.
+    updateSensorAggregates(heartRateTail, tempTail, motionTail, heartRate, temperature, motion,
+                           archiveIfOk ? nullptr : window.get(), archiveIfOk);
+    if (window && archiveIfOk) seedWindowFromBinaryLogs(*window, currentTimeMs());
+    for (bool first = true;; first = false) {
+        if (!first) {
+            // In window mode, wake up at least once per window so expired data drops out.
+            if (!waitForInputChange(inotifyFd, watchDirs, files, anyChangeDirs, window ? int64_t(options.windowSeconds) * 1000 : -1)
+                && !window)
+                continue;
+            updateSensorAggregates(heartRateTail, tempTail, motionTail, heartRate, temperature, motion, window.get(), archiveIfOk);
+        }
+        SensorSummary summary;
+        if (window) {
+            summary = window->summarize(currentTimeMs() / 1000);
+        } else {
+            tie(summary.avgBPM, summary.avgSpO2) = heartRate.averages();
+            summary.avgAmbient = temperature.ambientMedian.value();
+            summary.avgObject = temperature.objectMedian.value();
+            summary.bestMotion = motion.bestRMS();
+        }
+        finishProfileRuns({ generateProfile(options, SubjectPaths(), nullptr, &summary) });
+        cout << flush;
+    }
+}
+
+// ---------------------------
+// Batch Mode
+// ---------------------------
+// --batch=MANIFEST builds the profiles of many subjects in one process. The candidate
+// directories are loaded once and shared, and the subjects run in parallel, one per hardware
+// thread. The manifest is JSON:
+//   { "subjects": [ { "heart_rate_log": "...", "temperature_log": "...", "motion_log": "...",
+//                     "log_file": "...", "camera": true }, ... ] }
+// The three sensor logs are required; "log_file" defaults to LOG_FILE and "camera" to false.
+// Subject N is published to OUTPUT_DIR as state_profile-N.jpg, with state_profile-N.docx,
+// log_screenshot-N.jpg and camera_snapshot-N.jpg beside it.
+
+// Insert "-N" before the extension: "state_profile.docx" -> "state_profile-3.docx".
+string numberedOutput(const string &path, size_t n) {
+    fs::path p(path);
+    return (p.parent_path() / (p.stem().string() + "-" + to_string(n) + p.extension().string())).string();
+}
+
+bool readBatchManifest(const string &manifestPath, vector<SubjectPaths> &subjects) {
+    ifstream file(manifestPath);
+    if (!file) {
+        cerr << "Error: Could not open manifest " << manifestPath << endl;
+        return false;
+    }
+    Json::Value manifest;
+    try {
+        file >> manifest;
+    } catch (const exception &e) {
+        cerr << "Error: Invalid JSON in manifest " << manifestPath << ": " << e.what() << endl;
+        return false;
+    }
+    const Json::Value &entries = manifest.isObject() ? manifest["subjects"] : Json::Value::nullSingleton();
+    if (!entries.isArray() || entries.empty()) {
+        cerr << "Error: Manifest " << manifestPath << " has no \"subjects\" array." << endl;
+        return false;
+    }
+    for (Json::ArrayIndex n = 0; n < entries.size(); ++n) {
+        const Json::Value &entry = entries[n];
+        if (!entry.isObject()) {
+            cerr << "Error: Subject " << n << " of " << manifestPath << " is not an object." << endl;
+            return false;
+        }
+        const Json::Value &logFile = entry["log_file"], &camera = entry["camera"];
+        if (!logFile.isNull() && !logFile.isString()) {
+            cerr << "Error: Subject " << n << " of " << manifestPath << " has a \"log_file\" that is not a string." << endl;
+            return false;
+        }
+        if (!camera.isNull() && !camera.isBool()) {
+            cerr << "Error: Subject " << n << " of " << manifestPath << " has a \"camera\" that is not true or false." << endl;
+            return false;
+        }
+        SubjectPaths subject;
+        for (auto [key, path] : { make_pair("heart_rate_log", &subject.heartRateLog),
+                                  make_pair("temperature_log", &subject.tempLog),
+                                  make_pair("motion_log", &subject.motionLog) }) {
+            if (!entry[key].isString()) {
+                cerr << "Error: Subject " << n << " of " << manifestPath << " has no \"" << key << "\"." << endl;
+                return false;
+            }
+            *path = entry[key].asString();
+        }
+        if (logFile.isString()) subject.logFile = logFile.asString();
+        subject.finalImg = OUTPUT_DIR + "state_profile-" + to_string(n) + ".jpg";
+        subject.outputSet = "subject-" + to_string(n);
+        subject.finalDocx = numberedOutput(subject.finalDocx, n);
+        subject.logScreenshot = numberedOutput(subject.logScreenshot, n);
+        subject.cameraImage = camera.isBool() && camera.asBool() ? numberedOutput(CAMERA_IMAGE, n) : "";
+        subjects.push_back(move(subject));
+    }
+    return true;
+}
+
+// Independent stages one profile runs at the same time (sensor logs, log text, camera). Without
+// --jobs, a batch generates one subject per this many hardware threads, but at least
+// MIN_BATCH_JOBS so subjects still overlap on small boards.
+const size_t STAGES_PER_PROFILE = 4;
+const size_t MIN_BATCH_JOBS = 2;
+
+int runBatch(const Options &options) {
+    vector<SubjectPaths> subjects;
+    if (!readBatchManifest(options.batchManifest, subjects)) return 1;
+    auto start = chrono::steady_clock::now();
+
+    CandidateIndexes indexes;
+    {
+        ScopedTimer timer("batch: load candidate indexes");
+        indexes = loadCandidateIndexes();
+    }
+
+    // Each worker takes the next subject until none are left.
+    vector<PublishedProfile> runs(subjects.size());
+    atomic<size_t> next{0};
+    auto worker = [&] {
+        for (size_t n; (n = next++) < subjects.size();)
+            runs[n] = generateProfile(options, subjects[n], &indexes);
+    };
+    size_t jobs = options.batchJobs > 0 ? options.batchJobs
+                                        : max(MIN_BATCH_JOBS, size_t(thread::hardware_concurrency()) / STAGES_PER_PROFILE);
+    size_t workerCount = min(subjects.size(), jobs);
+    vector<thread> workers;
+    for (size_t i = 1; i < workerCount; ++i) workers.emplace_back(worker);
+    worker();
+    for (thread &w : workers) w.join();
+
+    finishProfileRuns(move(runs));
+    auto ms = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start).count();
+    cout << "Batch of " << subjects.size() << " subjects generated in " << ms << "ms.\n";
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        printUsage(argv[0]);
+        return 1;
+    }
+    if (options.benchLines > 0)
+        return runBench(options.benchLines);
+    if (options.convertLogs) {
+        bool ok = convertTextLogToBinary(HEART_RATE_LOG, SensorKind::HeartRate);
+        ok = convertTextLogToBinary(TEMP_LOG, SensorKind::Temperature) && ok;
+        ok = convertTextLogToBinary(MOTION_LOG, SensorKind::Motion) && ok;
+        return ok ? 0 : 1;
+    }
+    if (options.timingReport)
+        timingRecorder().enable();
+    int status = 0;
+    if (options.daemon)
+        status = runDaemon(options);
+    else if (!options.batchManifest.empty())
+        status = runBatch(options);
+    else
+        finishProfileRuns({ generateProfile(options) });
+    waitForOutputCollection();
+    return status;
 }